@@ -0,0 +1,122 @@
+#include "capture.h"
+#include "netaudio_wire.h"
+#include "transport.h"
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdexcept>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define CAPTURE_MAGIC "NACP"
+#define CAPTURE_VERSION 1u
+#define CAPTURE_HEADER_SIZE 16u
+#define CAPTURE_RECORD_SIZE 16u
+
+static size_t align8(size_t n)
+{
+  return (n + 7u) & ~(size_t)7u;
+}
+
+capture_writer_t::capture_writer_t(const std::string& path)
+    : fd(-1), start(get_time_ns()), packets(0)
+{
+  fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+  if(fd < 0)
+    throw std::runtime_error("Unable to create capture file \"" + path +
+                             "\": " + strerror(errno));
+  char header[CAPTURE_HEADER_SIZE];
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  memcpy(header, CAPTURE_MAGIC, 4);
+  store_le32(&(header[4]), CAPTURE_VERSION);
+  store_le64(&(header[8]), (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec);
+  if(::write(fd, header, CAPTURE_HEADER_SIZE) != CAPTURE_HEADER_SIZE) {
+    int e(errno);
+    close(fd);
+    throw std::runtime_error("Unable to write to capture file \"" + path +
+                             "\": " + strerror(e));
+  }
+}
+
+capture_writer_t::~capture_writer_t()
+{
+  close(fd);
+}
+
+bool capture_writer_t::write(const char* data, size_t len, uint64_t time)
+{
+  // each record is written with a single system call, so records
+  // remain complete:
+  size_t reclen(CAPTURE_RECORD_SIZE + align8(len));
+  if(buf.size() < reclen)
+    buf.resize(reclen);
+  store_le64(&(buf[0]), time - start);
+  store_le32(&(buf[8]), len);
+  store_le32(&(buf[12]), 0u);
+  memcpy(&(buf[CAPTURE_RECORD_SIZE]), data, len);
+  memset(&(buf[CAPTURE_RECORD_SIZE + len]), 0, align8(len) - len);
+  if(::write(fd, buf.data(), reclen) != (ssize_t)reclen)
+    return false;
+  ++packets;
+  return true;
+}
+
+capture_reader_t::capture_reader_t(const std::string& path)
+    : mem(NULL), memlen(0), pos(hdrlen), start(0)
+{
+  int fd(open(path.c_str(), O_RDONLY));
+  if(fd < 0)
+    throw std::runtime_error("Unable to open capture file \"" + path +
+                             "\": " + strerror(errno));
+  struct stat st;
+  if((fstat(fd, &st) != 0) || ((size_t)st.st_size < CAPTURE_HEADER_SIZE)) {
+    close(fd);
+    throw std::runtime_error("\"" + path + "\" is not a capture file.");
+  }
+  memlen = st.st_size;
+  void* m(mmap(NULL, memlen, PROT_READ, MAP_PRIVATE, fd, 0));
+  close(fd);
+  if(m == MAP_FAILED)
+    throw std::runtime_error("Unable to map capture file \"" + path +
+                             "\": " + strerror(errno));
+  mem = (const char*)m;
+  if((memcmp(mem, CAPTURE_MAGIC, 4) != 0) ||
+     (load_le32(&(mem[4])) != CAPTURE_VERSION)) {
+    munmap((void*)mem, memlen);
+    throw std::runtime_error("\"" + path + "\" is not a capture file.");
+  }
+  start = load_le64(&(mem[8]));
+}
+
+capture_reader_t::~capture_reader_t()
+{
+  munmap((void*)mem, memlen);
+}
+
+bool capture_reader_t::next(const char*& data, size_t& len,
+                            uint64_t& timestamp)
+{
+  if(memlen - pos < CAPTURE_RECORD_SIZE)
+    return false;
+  size_t plen(load_le32(&(mem[pos + 8])));
+  if(memlen - pos - CAPTURE_RECORD_SIZE < plen)
+    return false;
+  timestamp = load_le64(&(mem[pos]));
+  len = plen;
+  data = &(mem[pos + CAPTURE_RECORD_SIZE]);
+  pos += std::min(memlen - pos, CAPTURE_RECORD_SIZE + align8(plen));
+  return true;
+}
+
+/*
+ * Local Variables:
+ * mode: c++
+ * c-basic-offset: 2
+ * indent-tabs-mode: nil
+ * compile-command: "make -C .."
+ * End:
+ */
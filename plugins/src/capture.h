@@ -0,0 +1,98 @@
+/**
+ * @file capture.h
+ * @brief Packet capture files
+ *
+ * A capture file starts with a 16-byte header: the magic "NACP", a
+ * 32-bit version number and the 64-bit wall clock start time in
+ * nanoseconds since the epoch. It is followed by records of a 64-bit
+ * timestamp in nanoseconds since start, a 32-bit packet size, 32
+ * reserved bits and the packet, padded to a multiple of 8 bytes. All
+ * numbers are little-endian. Files are only appended to, and records
+ * are 8-byte aligned, so they can be accessed in place when the file
+ * is mapped into memory.
+ */
+
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Append packets with timestamps to a capture file
+ */
+class capture_writer_t {
+public:
+  /**
+   * @param path File name, an existing file is replaced
+   */
+  capture_writer_t(const std::string& path);
+  ~capture_writer_t();
+  /**
+   * Append a packet.
+   *
+   * @param data Packet data
+   * @param len Packet size in bytes
+   * @param time Time of monotonic clock in nanoseconds, see get_time_ns()
+   * @return True on success
+   *
+   * Each packet is passed to the operating system immediately, so
+   * the capture is complete even if the process terminates
+   * unexpectedly.
+   */
+  bool write(const char* data, size_t len, uint64_t time);
+  /// Number of packets written
+  size_t get_packets() const { return packets; };
+
+private:
+  int fd;
+  uint64_t start;
+  size_t packets;
+  std::vector<char> buf;
+};
+
+/**
+ * @brief Read packets from a memory-mapped capture file
+ */
+class capture_reader_t {
+public:
+  /**
+   * @param path File name
+   */
+  capture_reader_t(const std::string& path);
+  ~capture_reader_t();
+  /**
+   * Return the next packet.
+   *
+   * @param[out] data Pointer to packet, valid as long as the reader exists
+   * @param[out] len Packet size in bytes
+   * @param[out] timestamp Time of arrival in nanoseconds since start
+   * @return True if a packet was read, false at the end of the file
+   *
+   * An incomplete record at the end of the file is ignored.
+   */
+  bool next(const char*& data, size_t& len, uint64_t& timestamp);
+  /// Go back to the first packet
+  void rewind() { pos = hdrlen; };
+  /// Wall clock start time in nanoseconds since the epoch
+  uint64_t get_start() const { return start; };
+
+private:
+  const char* mem;
+  size_t memlen;
+  size_t pos;
+  uint64_t start;
+  static const size_t hdrlen = 16;
+};
+
+#endif
+
+/*
+ * Local Variables:
+ * mode: c++
+ * c-basic-offset: 2
+ * indent-tabs-mode: nil
+ * compile-command: "make -C .."
+ * End:
+ */
@@ -0,0 +1,77 @@
+#include <gtest/gtest.h>
+
+#include "capture.h"
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+TEST(capture, write_read)
+{
+  std::string path("/tmp/capture_test_" + std::to_string(getpid()) + ".nacp");
+  {
+    capture_writer_t writer(path);
+    EXPECT_TRUE(writer.write("abc", 3, 1000));
+    EXPECT_TRUE(writer.write("", 0, 2000));
+    EXPECT_TRUE(writer.write("0123456789", 10, 3500));
+    EXPECT_EQ(3u, writer.get_packets());
+  }
+  capture_reader_t reader(path);
+  const char* data(NULL);
+  size_t len(0);
+  uint64_t t0(0);
+  uint64_t t(0);
+  ASSERT_TRUE(reader.next(data, len, t0));
+  EXPECT_EQ(3u, len);
+  EXPECT_EQ(0, memcmp(data, "abc", 3));
+  // records are 8-byte aligned:
+  EXPECT_EQ(0u, (size_t)data % 8u);
+  ASSERT_TRUE(reader.next(data, len, t));
+  EXPECT_EQ(0u, len);
+  EXPECT_EQ(1000u, t - t0);
+  ASSERT_TRUE(reader.next(data, len, t));
+  EXPECT_EQ(10u, len);
+  EXPECT_EQ(0, memcmp(data, "0123456789", 10));
+  EXPECT_EQ(0u, (size_t)data % 8u);
+  EXPECT_EQ(2500u, t - t0);
+  EXPECT_FALSE(reader.next(data, len, t));
+  reader.rewind();
+  ASSERT_TRUE(reader.next(data, len, t));
+  EXPECT_EQ(3u, len);
+  EXPECT_LT(0u, reader.get_start());
+  unlink(path.c_str());
+}
+
+TEST(capture, truncated)
+{
+  std::string path("/tmp/capture_test_" + std::to_string(getpid()) + ".nacp");
+  {
+    capture_writer_t writer(path);
+    EXPECT_TRUE(writer.write("abc", 3, 0));
+    EXPECT_TRUE(writer.write("0123456789", 10, 0));
+  }
+  // incomplete last record, e.g., after a crash:
+  ASSERT_EQ(0, truncate(path.c_str(), 16 + 24 + 20));
+  {
+    capture_reader_t reader(path);
+    const char* data(NULL);
+    size_t len(0);
+    uint64_t t(0);
+    EXPECT_TRUE(reader.next(data, len, t));
+    EXPECT_FALSE(reader.next(data, len, t));
+  }
+  ASSERT_EQ(0, truncate(path.c_str(), 8));
+  EXPECT_THROW(capture_reader_t reader(path), std::runtime_error);
+  FILE* fh(fopen(path.c_str(), "w"));
+  fputs("this is not a capture file", fh);
+  fclose(fh);
+  EXPECT_THROW(capture_reader_t reader(path), std::runtime_error);
+  unlink(path.c_str());
+  EXPECT_THROW(capture_reader_t reader(path), std::runtime_error);
+}
+
+// Local Variables:
+// compile-command: "make -C .. unit-tests"
+// coding: utf-8-unix
+// c-basic-offset: 2
+// indent-tabs-mode: nil
+// End:
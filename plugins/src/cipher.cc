@@ -0,0 +1,221 @@
+#include "cipher.h"
+#include <openssl/evp.h>
+#include <openssl/kdf.h>
+#include <openssl/rand.h>
+#include <stdexcept>
+#include <algorithm>
+#include <string.h>
+#include <utility>
+
+// size of the replay window in packages, bits of the window mask:
+#define CIPHER_WINDOW 64u
+// time without packages after which a new salt is accepted:
+#define CIPHER_RESYNC_NS 1000000000u
+#define CIPHER_KEY_SIZE 32u
+#define CIPHER_NONCE_SIZE 12u
+// HKDF info of the keys of both directions:
+#define CIPHER_LABEL_STREAM "netaudio stream"
+#define CIPHER_LABEL_REPORT "netaudio report"
+
+static_assert(netaudio_sealed_data - netaudio_sealed_salt == CIPHER_NONCE_SIZE,
+              "salt and sequence number are not a 96 bit nonce");
+
+bool get_cipher_alg(const std::string& name, cipher_alg_t& alg)
+{
+  if(name == "chacha20-poly1305") {
+    alg = cipher_chacha20_poly1305;
+    return true;
+  }
+  if(name == "aes-256-gcm") {
+    alg = cipher_aes256_gcm;
+    return true;
+  }
+  return false;
+}
+
+static bool parse_key(const std::string& key, unsigned char* bytes)
+{
+  if(key.size() != 2u * CIPHER_KEY_SIZE)
+    return false;
+  for(size_t k = 0; k < key.size(); ++k) {
+    char c(key[k]);
+    int v(-1);
+    if((c >= '0') && (c <= '9'))
+      v = c - '0';
+    else if((c >= 'a') && (c <= 'f'))
+      v = c - 'a' + 10;
+    else if((c >= 'A') && (c <= 'F'))
+      v = c - 'A' + 10;
+    if(v < 0)
+      return false;
+    if(k & 1u)
+      bytes[k / 2u] |= v;
+    else
+      bytes[k / 2u] = v << 4;
+  }
+  return true;
+}
+
+static bool derive_key(const unsigned char* psk, const char* label,
+                       unsigned char* key)
+{
+  EVP_PKEY_CTX* ctx(EVP_PKEY_CTX_new_id(EVP_PKEY_HKDF, NULL));
+  size_t len(CIPHER_KEY_SIZE);
+  bool ok(ctx && (EVP_PKEY_derive_init(ctx) > 0) &&
+          (EVP_PKEY_CTX_set_hkdf_md(ctx, EVP_sha256()) > 0) &&
+          (EVP_PKEY_CTX_set1_hkdf_key(ctx, psk, CIPHER_KEY_SIZE) > 0) &&
+          (EVP_PKEY_CTX_add1_hkdf_info(ctx, (const unsigned char*)label,
+                                       strlen(label)) > 0) &&
+          (EVP_PKEY_derive(ctx, key, &len) > 0) && (len == CIPHER_KEY_SIZE));
+  EVP_PKEY_CTX_free(ctx);
+  return ok;
+}
+
+packet_cipher_t::packet_cipher_t(const std::string& key, cipher_role_t role,
+                                 cipher_alg_t alg)
+{
+  unsigned char keybytes[CIPHER_KEY_SIZE];
+  if(!parse_key(key, keybytes))
+    throw std::runtime_error(
+        "Invalid key (expected 64 hexadecimal digits, i.e., 256 bits).");
+  unsigned char streamkey[CIPHER_KEY_SIZE];
+  unsigned char reportkey[CIPHER_KEY_SIZE];
+  bool ok(derive_key(keybytes, CIPHER_LABEL_STREAM, streamkey) &&
+          derive_key(keybytes, CIPHER_LABEL_REPORT, reportkey));
+  const unsigned char* sealkey(streamkey);
+  const unsigned char* openkey(reportkey);
+  if(role == cipher_receiver)
+    std::swap(sealkey, openkey);
+  const EVP_CIPHER* cipher(EVP_chacha20_poly1305());
+  if(alg == cipher_aes256_gcm)
+    cipher = EVP_aes_256_gcm();
+  seal_ctx = EVP_CIPHER_CTX_new();
+  open_ctx = EVP_CIPHER_CTX_new();
+  // both algorithms use 96 bit nonces by default:
+  ok = ok && seal_ctx && open_ctx &&
+       EVP_EncryptInit_ex(seal_ctx, cipher, NULL, sealkey, NULL) &&
+       EVP_DecryptInit_ex(open_ctx, cipher, NULL, openkey, NULL) &&
+       (RAND_bytes((unsigned char*)salt, sizeof(salt)) == 1) &&
+       (RAND_bytes((unsigned char*)&seq, sizeof(seq)) == 1);
+  // the sequence number does not wrap around within a session:
+  seq &= ~((uint64_t)1u << 63);
+  OPENSSL_cleanse(keybytes, sizeof(keybytes));
+  OPENSSL_cleanse(streamkey, sizeof(streamkey));
+  OPENSSL_cleanse(reportkey, sizeof(reportkey));
+  if(!ok) {
+    EVP_CIPHER_CTX_free(seal_ctx);
+    EVP_CIPHER_CTX_free(open_ctx);
+    throw std::runtime_error("Unable to initialize cipher.");
+  }
+}
+
+packet_cipher_t::~packet_cipher_t()
+{
+  EVP_CIPHER_CTX_free(seal_ctx);
+  EVP_CIPHER_CTX_free(open_ctx);
+}
+
+size_t packet_cipher_t::seal(char* data, size_t len, size_t packetlen)
+{
+  if((len < packetlen + overhead) || (packetlen > NETAUDIO_MAX_PACKET_SIZE))
+    return 0u;
+  data[netaudio_sealed_type] = NETAUDIO_SEALED;
+  memcpy(&(data[netaudio_sealed_salt]), salt, sizeof(salt));
+  store_le64(&(data[netaudio_sealed_seq]), seq);
+  ++seq;
+  unsigned char* p((unsigned char*)data);
+  unsigned char* payload(&(p[netaudio_sealed_data]));
+  int outlen(0);
+  int finallen(0);
+  // the nonce is the salt and the sequence number:
+  if(!EVP_EncryptInit_ex(seal_ctx, NULL, NULL, NULL,
+                         &(p[netaudio_sealed_salt])) ||
+     !EVP_EncryptUpdate(seal_ctx, NULL, &outlen, p, netaudio_sealed_data) ||
+     !EVP_EncryptUpdate(seal_ctx, payload, &outlen, payload, packetlen) ||
+     !EVP_EncryptFinal_ex(seal_ctx, &(payload[outlen]), &finallen) ||
+     !EVP_CIPHER_CTX_ctrl(seal_ctx, EVP_CTRL_AEAD_GET_TAG,
+                          netaudio_sealed_tagsize, &(payload[packetlen])))
+    return 0u;
+  return packetlen + overhead;
+}
+
+size_t packet_cipher_t::open(const char* data, size_t len, char* packet,
+                             size_t packetlen, uint64_t arrival)
+{
+  if((len < overhead) || (len > NETAUDIO_MAX_PACKET_SIZE + overhead) ||
+     (data[netaudio_sealed_type] != NETAUDIO_SEALED) ||
+     (packetlen < len - overhead)) {
+    ++rejected;
+    return 0u;
+  }
+  const char* psalt(&(data[netaudio_sealed_salt]));
+  uint64_t pseq(load_le64(&(data[netaudio_sealed_seq])));
+  // replays are detected before decryption:
+  bool new_peer(!has_peer || memcmp(psalt, peer_salt, sizeof(peer_salt)));
+  if(new_peer) {
+    if(has_peer && (arrival - last_arrival < CIPHER_RESYNC_NS)) {
+      ++replayed;
+      return 0u;
+    }
+    // recorded earlier sessions:
+    size_t nold(std::min(old_salt_count, (size_t)CIPHER_SALT_HISTORY));
+    for(size_t k = 0; k < nold; ++k)
+      if(!memcmp(psalt, old_salts[k], sizeof(peer_salt))) {
+        ++replayed;
+        return 0u;
+      }
+  } else if(pseq <= highest) {
+    uint64_t d(highest - pseq);
+    if((d >= CIPHER_WINDOW) || (window & ((uint64_t)1u << d))) {
+      ++replayed;
+      return 0u;
+    }
+  }
+  const unsigned char* p((const unsigned char*)data);
+  size_t clen(len - overhead);
+  int outlen(0);
+  int finallen(0);
+  if(!EVP_DecryptInit_ex(open_ctx, NULL, NULL, NULL,
+                         &(p[netaudio_sealed_salt])) ||
+     !EVP_DecryptUpdate(open_ctx, NULL, &outlen, p, netaudio_sealed_data) ||
+     !EVP_DecryptUpdate(open_ctx, (unsigned char*)packet, &outlen,
+                        &(p[netaudio_sealed_data]), clen) ||
+     !EVP_CIPHER_CTX_ctrl(open_ctx, EVP_CTRL_AEAD_SET_TAG,
+                          netaudio_sealed_tagsize,
+                          (void*)&(p[netaudio_sealed_data + clen])) ||
+     (EVP_DecryptFinal_ex(open_ctx, (unsigned char*)&(packet[outlen]),
+                          &finallen) <= 0)) {
+    ++rejected;
+    return 0u;
+  }
+  // the window is only updated by authentic packages:
+  if(new_peer) {
+    if(has_peer) {
+      memcpy(old_salts[old_salt_count % CIPHER_SALT_HISTORY], peer_salt,
+             sizeof(peer_salt));
+      ++old_salt_count;
+    }
+    memcpy(peer_salt, psalt, sizeof(peer_salt));
+    has_peer = true;
+    highest = pseq;
+    window = 1u;
+  } else if(pseq > highest) {
+    uint64_t shift(pseq - highest);
+    window = (shift >= CIPHER_WINDOW) ? 0u : (window << shift);
+    window |= 1u;
+    highest = pseq;
+  } else {
+    window |= (uint64_t)1u << (highest - pseq);
+  }
+  last_arrival = arrival;
+  return clen;
+}
+
+/*
+ * Local Variables:
+ * mode: c++
+ * c-basic-offset: 2
+ * indent-tabs-mode: nil
+ * compile-command: "make -C .."
+ * End:
+ */
@@ -0,0 +1,138 @@
+/**
+ * @file cipher.h
+ * @brief Encryption and authentication of netaudio packages
+ */
+
+#ifndef CIPHER_H
+#define CIPHER_H
+
+#include "netaudio_wire.h"
+#include <atomic>
+#include <stdint.h>
+#include <string>
+
+typedef struct evp_cipher_ctx_st EVP_CIPHER_CTX;
+
+/// Number of previous sender salts which are rejected as replays
+#define CIPHER_SALT_HISTORY 16u
+
+/// AEAD algorithms of sealed packages
+enum cipher_alg_t { cipher_chacha20_poly1305, cipher_aes256_gcm };
+
+/// Side of a stream, which selects the keys of both directions
+enum cipher_role_t {
+  /// Seals the stream, opens receiver reports
+  cipher_sender,
+  /// Opens the stream, seals receiver reports
+  cipher_receiver
+};
+
+/**
+ * Convert the name of an AEAD algorithm.
+ *
+ * @param[in] name "chacha20-poly1305" or "aes-256-gcm"
+ * @param[out] alg Algorithm
+ * @return False if the name is invalid
+ */
+bool get_cipher_alg(const std::string& name, cipher_alg_t& alg);
+
+/**
+ * @brief Seal and open netaudio packages with a pre-shared key
+ *
+ * Packages of any type are sealed into NETAUDIO_SEALED packages
+ * (see netaudio_sealed_type), which are encrypted and authenticated
+ * with ChaCha20-Poly1305 or AES-256-GCM, using OpenSSL. AES-GCM uses
+ * AES-NI where available, ChaCha20-Poly1305 is faster on CPUs
+ * without AES instructions.
+ *
+ * Separate keys for the stream and for the receiver reports are
+ * derived from the pre-shared key with HKDF-SHA256, so the two
+ * directions never share a nonce space.
+ *
+ * Every sealing side chooses a random 32 bit salt, and numbers its
+ * packages with a 64 bit sequence number starting at a random value
+ * below 2^63, which together form the nonce. Two sessions thus only
+ * reuse a nonce if both the salt and the ranges of sequence numbers
+ * overlap. The receiving side rejects packages which were already
+ * received, or which are older than a window of 64 packages. A new
+ * salt, i.e., a restarted sender, is only accepted if no package
+ * with the current salt was received for one second, and if it is
+ * not one of the 16 previously accepted salts. Old sessions can thus
+ * not be replayed while a stream is received, nor after one of the
+ * last 16 sender restarts. Older recorded sessions can still be
+ * replayed while the sender is silent for more than one second, since
+ * the session start is not authenticated interactively.
+ *
+ * seal() and open() use separate states, and may be called by
+ * different threads.
+ */
+class packet_cipher_t {
+public:
+  /**
+   * @param key Pre-shared key of 256 bits, as 64 hexadecimal digits
+   * @param role Side of the stream
+   * @param alg AEAD algorithm
+   */
+  packet_cipher_t(const std::string& key, cipher_role_t role,
+                  cipher_alg_t alg = cipher_chacha20_poly1305);
+  ~packet_cipher_t();
+  /// Number of bytes added to a package by sealing
+  static constexpr size_t overhead =
+      netaudio_sealed_data + netaudio_sealed_tagsize;
+  /**
+   * Seal a package in place.
+   *
+   * @param data Buffer with the package at data+netaudio_sealed_data
+   * @param len Size of buffer in bytes
+   * @param packetlen Size of package in bytes
+   * @return Size of sealed package, or zero if the buffer is too
+   * small or encryption failed
+   */
+  size_t seal(char* data, size_t len, size_t packetlen);
+  /**
+   * Open a sealed package.
+   *
+   * @param data Sealed package
+   * @param len Size of sealed package in bytes
+   * @param packet Buffer for the package
+   * @param packetlen Size of buffer in bytes
+   * @param arrival Arrival time in nanoseconds, see get_time_ns()
+   * @return Size of package, or zero if the package is invalid, not
+   * authentic, or a replay
+   */
+  size_t open(const char* data, size_t len, char* packet, size_t packetlen,
+              uint64_t arrival);
+  /// Number of packages which were invalid or not authentic
+  size_t get_rejected() const { return rejected; };
+  /// Number of authentic packages which were rejected as replays
+  size_t get_replayed() const { return replayed; };
+
+private:
+  EVP_CIPHER_CTX* seal_ctx = NULL;
+  EVP_CIPHER_CTX* open_ctx = NULL;
+  // sealing state:
+  char salt[4];
+  uint64_t seq = 0;
+  // replay window of the opening side:
+  bool has_peer = false;
+  char peer_salt[4];
+  uint64_t highest = 0;
+  uint64_t window = 0;
+  uint64_t last_arrival = 0;
+  // salts of the previous senders, in a ring:
+  char old_salts[CIPHER_SALT_HISTORY][4];
+  size_t old_salt_count = 0;
+  std::atomic<size_t> rejected = 0;
+  std::atomic<size_t> replayed = 0;
+};
+
+#endif
+
+/*
+ * Local Variables:
+ * mode: c++
+ * c-basic-offset: 2
+ * indent-tabs-mode: nil
+ * compile-command: "make -C .."
+ * End:
+ */
@@ -0,0 +1,156 @@
+#include <gtest/gtest.h>
+
+#include "cipher.h"
+#include <stdexcept>
+#include <vector>
+
+static const std::string key(
+    "000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1F");
+
+static size_t seal(packet_cipher_t& cipher, const std::string& packet,
+                   std::vector<char>& data)
+{
+  data.resize(packet.size() + packet_cipher_t::overhead);
+  memcpy(&(data[netaudio_sealed_data]), packet.data(), packet.size());
+  return cipher.seal(data.data(), data.size(), packet.size());
+}
+
+TEST(cipher, seal_open)
+{
+  for(cipher_alg_t alg : {cipher_chacha20_poly1305, cipher_aes256_gcm}) {
+    packet_cipher_t sender(key, cipher_sender, alg);
+    packet_cipher_t receiver(key, cipher_receiver, alg);
+    std::string packet("\002 audio package");
+    std::vector<char> data;
+    size_t len(seal(sender, packet, data));
+    ASSERT_EQ(packet.size() + 29u, len);
+    EXPECT_EQ(NETAUDIO_SEALED, data[0]);
+    // the sequence starts at a random value below 2^63:
+    uint64_t seq(load_le64(&(data[netaudio_sealed_seq])));
+    EXPECT_GT((uint64_t)1u << 63, seq);
+    // encrypted:
+    EXPECT_NE(0, memcmp(&(data[netaudio_sealed_data]), packet.data(),
+                        packet.size()));
+    char out[64];
+    ASSERT_EQ(packet.size(), receiver.open(data.data(), len, out, 64, 0));
+    EXPECT_EQ(packet, std::string(out, packet.size()));
+    // every byte is authenticated:
+    for(size_t k = 0; k < len; ++k) {
+      data[k] ^= 0x10;
+      EXPECT_EQ(0u, receiver.open(data.data(), len, out, 64, 0)) << k;
+      data[k] ^= 0x10;
+    }
+    EXPECT_EQ(0u, receiver.open(data.data(), len - 1, out, 64, 0));
+    // output buffer too small:
+    EXPECT_EQ(0u, receiver.open(data.data(), len, out, 4, 0));
+    // wrong key:
+    std::string key2(key);
+    key2[0] = '1';
+    packet_cipher_t other(key2, cipher_receiver, alg);
+    EXPECT_EQ(0u, other.open(data.data(), len, out, 64, 0));
+    // the algorithms are not compatible:
+    packet_cipher_t other_alg(key, cipher_receiver,
+                              (alg == cipher_aes256_gcm)
+                                  ? cipher_chacha20_poly1305
+                                  : cipher_aes256_gcm);
+    EXPECT_EQ(0u, other_alg.open(data.data(), len, out, 64, 0));
+    // the buffer must have space for the overhead:
+    EXPECT_EQ(0u, sender.seal(data.data(), packet.size() + 28u,
+                              packet.size()));
+    // consecutive sequence numbers, the failed call used none:
+    seal(sender, packet, data);
+    EXPECT_EQ(seq + 1u, load_le64(&(data[netaudio_sealed_seq])));
+  }
+}
+
+TEST(cipher, directions)
+{
+  // streams and reports use different keys:
+  packet_cipher_t sender(key, cipher_sender);
+  packet_cipher_t receiver(key, cipher_receiver);
+  packet_cipher_t receiver2(key, cipher_receiver);
+  packet_cipher_t sender2(key, cipher_sender);
+  std::vector<char> data;
+  char out[16];
+  size_t len(seal(receiver, "\004report", data));
+  EXPECT_EQ(0u, receiver2.open(data.data(), len, out, 16, 0));
+  EXPECT_EQ(7u, sender.open(data.data(), len, out, 16, 0));
+  len = seal(sender2, "\002abc", data);
+  EXPECT_EQ(0u, sender.open(data.data(), len, out, 16, 0));
+  EXPECT_EQ(4u, receiver.open(data.data(), len, out, 16, 0));
+  // sessions differ in salt and sequence number:
+  std::vector<char> data2;
+  seal(sender, "\002abc", data2);
+  EXPECT_NE(0, memcmp(&(data[netaudio_sealed_salt]),
+                      &(data2[netaudio_sealed_salt]),
+                      netaudio_sealed_data - netaudio_sealed_salt));
+}
+
+TEST(cipher, replay)
+{
+  packet_cipher_t sender(key, cipher_sender);
+  packet_cipher_t receiver(key, cipher_receiver);
+  std::vector<std::vector<char>> packets(100);
+  for(auto& data : packets)
+    ASSERT_NE(0u, seal(sender, "\002abc", data));
+  char out[16];
+  ASSERT_EQ(4u, receiver.open(packets[0].data(), packets[0].size(), out, 16,
+                              0));
+  EXPECT_EQ(0u, receiver.open(packets[0].data(), packets[0].size(), out, 16,
+                              0));
+  EXPECT_EQ(1u, receiver.get_replayed());
+  // reordered packages within the window are accepted once:
+  EXPECT_EQ(4u, receiver.open(packets[70].data(), packets[70].size(), out,
+                              16, 0));
+  EXPECT_EQ(4u, receiver.open(packets[10].data(), packets[10].size(), out,
+                              16, 0));
+  EXPECT_EQ(0u, receiver.open(packets[10].data(), packets[10].size(), out,
+                              16, 0));
+  EXPECT_EQ(4u, receiver.open(packets[69].data(), packets[69].size(), out,
+                              16, 0));
+  // older than the window:
+  EXPECT_EQ(0u, receiver.open(packets[5].data(), packets[5].size(), out, 16,
+                              0));
+  EXPECT_EQ(3u, receiver.get_replayed());
+  EXPECT_EQ(0u, receiver.get_rejected());
+  // a new sender is only accepted after one second without packages:
+  packet_cipher_t sender2(key, cipher_sender);
+  std::vector<char> data;
+  seal(sender2, "\002xyz", data);
+  EXPECT_EQ(0u, receiver.open(data.data(), data.size(), out, 16, 999999999));
+  EXPECT_EQ(4u, receiver.open(data.data(), data.size(), out, 16, 1000000000));
+  EXPECT_EQ(0, memcmp(out, "\002xyz", 4));
+  // the old session is then rejected:
+  EXPECT_EQ(0u, receiver.open(packets[99].data(), packets[99].size(), out,
+                              16, 1000000001));
+  // also after one second without packages, as a previous salt:
+  EXPECT_EQ(0u, receiver.open(packets[99].data(), packets[99].size(), out,
+                              16, 3000000000));
+  EXPECT_EQ(6u, receiver.get_replayed());
+  // a new session is accepted:
+  packet_cipher_t sender3(key, cipher_sender);
+  seal(sender3, "\002uvw", data);
+  EXPECT_EQ(4u, receiver.open(data.data(), data.size(), out, 16, 3000000000));
+}
+
+TEST(cipher, config)
+{
+  cipher_alg_t alg(cipher_aes256_gcm);
+  EXPECT_TRUE(get_cipher_alg("chacha20-poly1305", alg));
+  EXPECT_EQ(cipher_chacha20_poly1305, alg);
+  EXPECT_TRUE(get_cipher_alg("aes-256-gcm", alg));
+  EXPECT_EQ(cipher_aes256_gcm, alg);
+  EXPECT_FALSE(get_cipher_alg("none", alg));
+  EXPECT_THROW(packet_cipher_t("", cipher_sender), std::runtime_error);
+  EXPECT_THROW(packet_cipher_t(key.substr(1), cipher_sender),
+               std::runtime_error);
+  EXPECT_THROW(packet_cipher_t("x" + key.substr(1), cipher_sender),
+               std::runtime_error);
+}
+
+// Local Variables:
+// compile-command: "make -C .. unit-tests"
+// coding: utf-8-unix
+// c-basic-offset: 2
+// indent-tabs-mode: nil
+// End:
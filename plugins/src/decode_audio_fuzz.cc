@@ -0,0 +1,48 @@
+/**
+ * @file decode_audio_fuzz.cc
+ * @brief Fuzzing harness for decode_audio()
+ *
+ * The first four bytes of the input select a stream configuration,
+ * the remaining bytes are decoded as an audio chunk of this stream.
+ */
+
+#include "netaudio.h"
+#include <math.h>
+#include <stdlib.h>
+#include <vector>
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+  if(size < 4u)
+    return 0;
+  samplefmt_t fmt((data[0] & 1u) ? pcmfloat : pcm16bit);
+  uint16_t channels(1u + data[1] % NETAUDIO_MAX_CHANNELS);
+  uint32_t fragsize(1u + (data[2] | (data[3] << 8)) % NETAUDIO_MAX_FRAGSIZE);
+  netaudio_info_t info(new_netaudio_info(48000, fmt, channels, fragsize));
+  if(get_buffer_length(info) > NETAUDIO_MAX_PACKET_SIZE)
+    return 0;
+  // poison the output, to detect samples which are not written:
+  std::vector<float> audio(channels * fragsize, NAN);
+  uint32_t sample_index;
+  netaudio_err_t err;
+  size_t len(decode_audio(new_netaudio_codec(info), audio.data(), audio.size(),
+                          sample_index, (const char*)(data + 4), size - 4u,
+                          err));
+  if(!len)
+    return 0;
+  if(len > size - 4u)
+    abort();
+  for(auto v : audio)
+    if(v != v)
+      abort();
+  return 0;
+}
+
+/*
+ * Local Variables:
+ * mode: c++
+ * c-basic-offset: 2
+ * indent-tabs-mode: nil
+ * compile-command: "make -C .. fuzzers"
+ * End:
+ */
@@ -0,0 +1,35 @@
+/**
+ * @file decode_header_fuzz.cc
+ * @brief Fuzzing harness for decode_header()
+ *
+ * Build with "make fuzzers", and run, e.g., with
+ * "build/decode_header_fuzz -max_total_time=600".
+ */
+
+#include "netaudio.h"
+#include <stdlib.h>
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+  netaudio_info_t info;
+  netaudio_err_t err;
+  if(!decode_header(info, (const char*)data, size, err))
+    return 0;
+  // accepted stream configurations can be decoded, within the limits:
+  if((info.channels < 1u) || (info.channels > NETAUDIO_MAX_CHANNELS) ||
+     (info.fragsize < 1u) || (info.fragsize > NETAUDIO_MAX_FRAGSIZE) ||
+     (get_buffer_length(info) > NETAUDIO_MAX_PACKET_SIZE))
+    abort();
+  if(!new_netaudio_codec(info).decode)
+    abort();
+  return 0;
+}
+
+/*
+ * Local Variables:
+ * mode: c++
+ * c-basic-offset: 2
+ * indent-tabs-mode: nil
+ * compile-command: "make -C .. fuzzers"
+ * End:
+ */
@@ -0,0 +1,88 @@
+#include "dither.h"
+#include "netaudio_codec.h"
+
+// noise shaping filter coefficients (Wannamaker 1992, 3-tap):
+#define NS_H1 1.623f
+#define NS_H2 -0.982f
+#define NS_H3 0.109f
+
+// largest requantization error fed back, in LSB, to keep the noise
+// shaping stable when the signal is clipped:
+#define NS_MAX_ERROR 2.0f
+
+bool get_dither_mode(const std::string& name, dither_mode_t& mode)
+{
+  if(name == "none")
+    mode = dither_none;
+  else if(name == "tpdf")
+    mode = dither_tpdf;
+  else if(name == "shaped")
+    mode = dither_shaped;
+  else
+    return false;
+  return true;
+}
+
+dither_t::dither_t(size_t channels, dither_mode_t mode, uint32_t seed)
+    : channels(channels), mode(mode), state(channels), err1(channels),
+      err2(channels), err3(channels)
+{
+  for(size_t c = 0; c < channels; ++c) {
+    // different, non-zero seeds for each channel:
+    uint32_t s(seed + 0x9e3779b9u * (c + 1u));
+    state[c] = s ? s : 1u;
+  }
+}
+
+static inline uint32_t xorshift32(uint32_t s)
+{
+  s ^= s << 13;
+  s ^= s >> 17;
+  s ^= s << 5;
+  return s;
+}
+
+void dither_t::process(float* audio, size_t frames)
+{
+  const float scale((1 << 15) - 1);
+  const float iscale(1.0f / scale);
+  // uniform random numbers in [-0.5,0.5) LSB:
+  const float rscale(1.0f / 4294967296.0f);
+  const bool shaped(mode == dither_shaped);
+  uint32_t* __restrict s(state.data());
+  float* __restrict e1(err1.data());
+  float* __restrict e2(err2.data());
+  float* __restrict e3(err3.data());
+  for(size_t k = 0; k < frames; ++k) {
+    float* __restrict frame(&(audio[k * channels]));
+    if(mode == dither_none) {
+      for(size_t c = 0; c < channels; ++c)
+        frame[c] = netaudio_sample_t<pcm16bit>::quantize(frame[c] * scale) *
+                   iscale;
+      continue;
+    }
+    for(size_t c = 0; c < channels; ++c) {
+      float v(frame[c] * scale);
+      if(shaped)
+        v -= NS_H1 * e1[c] + NS_H2 * e2[c] + NS_H3 * e3[c];
+      uint32_t r1(xorshift32(s[c]));
+      uint32_t r2(xorshift32(r1));
+      s[c] = r2;
+      float d(((float)(int32_t)r1 + (float)(int32_t)r2) * rscale);
+      float q(netaudio_sample_t<pcm16bit>::quantize(v + d));
+      e3[c] = e2[c];
+      e2[c] = e1[c];
+      e1[c] = std::max(-NS_MAX_ERROR, std::min(NS_MAX_ERROR, q - v));
+      frame[c] = q * iscale;
+    }
+  }
+}
+
+/*
+ * Local Variables:
+ * mode: c++
+ * c-basic-offset: 2
+ * indent-tabs-mode: nil
+ * compile-command: "make -C .."
+ * End:
+ */
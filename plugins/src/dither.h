@@ -0,0 +1,79 @@
+/**
+ * @file dither.h
+ * @brief Dither and noise shaping for requantization to 16 bit
+ */
+
+#ifndef DITHER_H
+#define DITHER_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+/**
+ * List of dither modes.
+ */
+enum dither_mode_t {
+  dither_none,  ///< rounding only
+  dither_tpdf,  ///< triangular PDF dither of 2 LSB peak-to-peak
+  dither_shaped ///< TPDF dither with noise shaping
+};
+
+/**
+ * Parse a dither mode name ("none", "tpdf" or "shaped").
+ *
+ * @param name Name of dither mode
+ * @param[out] mode Dither mode
+ * @return True if the name is valid
+ */
+bool get_dither_mode(const std::string& name, dither_mode_t& mode);
+
+/**
+ * @brief Requantize audio to the pcm16bit resolution
+ *
+ * The samples are replaced by the values which the pcm16bit encoder
+ * transmits, after adding dither and optionally shaping the
+ * requantization noise. Noise shaping uses the 3-tap error feedback
+ * filter by Wannamaker, designed for 44.1 kHz, which moves noise
+ * from the most sensitive range of hearing to high frequencies.
+ *
+ * Each channel has an independent xorshift random number generator,
+ * so the inner loop over the channels of a frame can be vectorized.
+ */
+class dither_t {
+public:
+  /**
+   * @param channels Number of channels
+   * @param mode Dither mode
+   * @param seed Seed of random number generators, non-zero
+   */
+  dither_t(size_t channels, dither_mode_t mode, uint32_t seed = 1);
+  /**
+   * Requantize in place.
+   *
+   * @param audio Interleaved audio samples
+   * @param frames Number of frames
+   */
+  void process(float* audio, size_t frames);
+
+private:
+  size_t channels;
+  dither_mode_t mode;
+  std::vector<uint32_t> state;
+  // requantization errors of the last three samples:
+  std::vector<float> err1;
+  std::vector<float> err2;
+  std::vector<float> err3;
+};
+
+#endif
+
+/*
+ * Local Variables:
+ * mode: c++
+ * c-basic-offset: 2
+ * indent-tabs-mode: nil
+ * compile-command: "make -C .."
+ * End:
+ */
@@ -0,0 +1,28 @@
+#include <benchmark/benchmark.h>
+
+#include "dither.h"
+#include <vector>
+
+static void BM_dither_process(benchmark::State& state)
+{
+  dither_mode_t mode((dither_mode_t)state.range(0));
+  size_t channels(state.range(1));
+  size_t frames(state.range(2));
+  dither_t dither(channels, mode);
+  std::vector<float> audio(channels * frames, 0.25f);
+  for(auto _ : state) {
+    dither.process(audio.data(), frames);
+    benchmark::DoNotOptimize(audio.data());
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * channels * frames);
+}
+BENCHMARK(BM_dither_process)
+    ->ArgsProduct({{dither_none, dither_tpdf, dither_shaped}, {2, 8}, {64}});
+
+// Local Variables:
+// compile-command: "make -C .. benchmarks"
+// coding: utf-8-unix
+// c-basic-offset: 2
+// indent-tabs-mode: nil
+// End:
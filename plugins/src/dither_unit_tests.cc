@@ -0,0 +1,178 @@
+#include <gtest/gtest.h>
+
+#include "dither.h"
+#include "netaudio.h"
+#include <algorithm>
+#include <math.h>
+#include <vector>
+
+#define SRATE 48000
+// test frequency, integer number of periods in one second:
+#define FREQ 997
+
+// Transmit a mono signal with pcm16bit samples, optionally dithered.
+static std::vector<float> transmit(const std::vector<float>& x,
+                                   dither_mode_t mode)
+{
+  const size_t fragsize(480);
+  netaudio_info_t info(new_netaudio_info(SRATE, pcm16bit, 1, fragsize));
+  dither_t dither(1, mode);
+  std::vector<float> y(x);
+  std::vector<char> data(get_buffer_length(info));
+  netaudio_err_t err;
+  for(size_t k = 0; k + fragsize <= y.size(); k += fragsize) {
+    if(mode != dither_none)
+      dither.process(&(y[k]), fragsize);
+    encode_audio(info, &(y[k]), fragsize, 0, data.data(), data.size(), err);
+    uint32_t sample_index(0);
+    decode_audio(info, &(y[k]), fragsize, sample_index, data.data(),
+                 data.size(), err);
+  }
+  return y;
+}
+
+static std::vector<float> sine(float amplitude)
+{
+  std::vector<float> x(SRATE);
+  for(size_t k = 0; k < x.size(); ++k)
+    x[k] = amplitude * sin(2.0 * M_PI * FREQ * k / SRATE);
+  return x;
+}
+
+// Amplitude of a harmonic of the test frequency.
+static double harmonic(const std::vector<float>& y, size_t n)
+{
+  double re(0.0);
+  double im(0.0);
+  for(size_t k = 0; k < y.size(); ++k) {
+    re += y[k] * cos(2.0 * M_PI * n * FREQ * k / SRATE);
+    im += y[k] * sin(2.0 * M_PI * n * FREQ * k / SRATE);
+  }
+  return 2.0 * sqrt(re * re + im * im) / y.size();
+}
+
+// Total harmonic distortion and noise in dB, relative to the
+// fundamental.
+static double thdn(const std::vector<float>& y)
+{
+  double a(0.0);
+  double b(0.0);
+  for(size_t k = 0; k < y.size(); ++k) {
+    a += y[k] * sin(2.0 * M_PI * FREQ * k / SRATE);
+    b += y[k] * cos(2.0 * M_PI * FREQ * k / SRATE);
+  }
+  a *= 2.0 / y.size();
+  b *= 2.0 / y.size();
+  double residual(0.0);
+  for(size_t k = 0; k < y.size(); ++k) {
+    double r(y[k] - a * sin(2.0 * M_PI * FREQ * k / SRATE) -
+             b * cos(2.0 * M_PI * FREQ * k / SRATE));
+    residual += r * r;
+  }
+  return 10.0 * log10(residual / y.size() / (0.5 * (a * a + b * b)));
+}
+
+// Power of the requantization error, in LSB^2, below approx. 1 kHz.
+static double lowfreq_noise(const std::vector<float>& x,
+                            const std::vector<float>& y)
+{
+  const double c(exp(-2.0 * M_PI * 1000.0 / SRATE));
+  double lp[4] = {0.0, 0.0, 0.0, 0.0};
+  double power(0.0);
+  for(size_t k = 0; k < x.size(); ++k) {
+    double v((y[k] - x[k]) * 32767.0);
+    for(size_t n = 0; n < 4; ++n)
+      v = lp[n] = c * lp[n] + (1.0 - c) * v;
+    power += v * v;
+  }
+  return power / x.size();
+}
+
+TEST(dither, get_dither_mode)
+{
+  dither_mode_t mode(dither_none);
+  EXPECT_TRUE(get_dither_mode("tpdf", mode));
+  EXPECT_EQ(dither_tpdf, mode);
+  EXPECT_TRUE(get_dither_mode("shaped", mode));
+  EXPECT_EQ(dither_shaped, mode);
+  EXPECT_TRUE(get_dither_mode("none", mode));
+  EXPECT_EQ(dither_none, mode);
+  EXPECT_FALSE(get_dither_mode("rectangular", mode));
+  EXPECT_EQ(dither_none, mode);
+}
+
+TEST(dither, thdn)
+{
+  // 16 bit quantization noise of a -6 dBFS sine is at -92 dB:
+  std::vector<float> y(transmit(sine(0.5f), dither_none));
+  EXPECT_GT(-90.0, thdn(y));
+  EXPECT_LT(-95.0, thdn(y));
+  // TPDF dither triples the noise power:
+  y = transmit(sine(0.5f), dither_tpdf);
+  EXPECT_GT(-86.0, thdn(y));
+  EXPECT_LT(-89.0, thdn(y));
+  y = transmit(sine(0.5f), dither_shaped);
+  EXPECT_GT(-75.0, thdn(y));
+}
+
+TEST(dither, saturation)
+{
+  std::vector<float> x(sine(1.5f));
+  for(auto mode : {dither_none, dither_tpdf, dither_shaped}) {
+    std::vector<float> y(transmit(x, mode));
+    for(size_t k = 0; k < x.size(); ++k) {
+      ASSERT_GE(1.0f, y[k]) << k;
+      ASSERT_LE(-32768.0f / 32767.0f, y[k]) << k;
+      // no wrap-around:
+      if(x[k] > 0.1f) {
+        ASSERT_LT(0.0f, y[k]) << k;
+      }
+      if(x[k] < -0.1f) {
+        ASSERT_GT(0.0f, y[k]) << k;
+      }
+    }
+    // clipped signal, but noise shaping remains stable:
+    EXPECT_NEAR(1.0f, y[SRATE / FREQ / 4], 0.001f);
+  }
+}
+
+TEST(dither, low_level_distortion)
+{
+  // sine with an amplitude of 2 LSB:
+  std::vector<float> x(sine(2.0f / 32767.0f));
+  std::vector<float> y(transmit(x, dither_none));
+  double h1(harmonic(y, 1));
+  // without dither, the quantization error is correlated with the
+  // signal:
+  double hmax(0.0);
+  for(size_t n = 2; n < 8; ++n)
+    hmax = std::max(hmax, harmonic(y, n) / h1);
+  EXPECT_LT(0.05, hmax);
+  y = transmit(x, dither_tpdf);
+  EXPECT_NEAR(h1, harmonic(y, 1), 0.1 * h1);
+  for(size_t n = 2; n < 8; ++n)
+    EXPECT_GT(0.01, harmonic(y, n) / h1) << n;
+  // noise power of rounding plus TPDF dither is 1/4 LSB^2:
+  double noise(0.0);
+  for(size_t k = 0; k < x.size(); ++k) {
+    double e((y[k] - x[k]) * 32767.0);
+    noise += e * e;
+  }
+  EXPECT_NEAR(0.25, noise / x.size(), 0.02);
+}
+
+TEST(dither, noise_shaping)
+{
+  std::vector<float> x(sine(0.01f));
+  double tpdf(lowfreq_noise(x, transmit(x, dither_tpdf)));
+  double shaped(lowfreq_noise(x, transmit(x, dither_shaped)));
+  // noise is moved to higher frequencies:
+  EXPECT_GT(0.25 * tpdf, shaped);
+}
+
+// Local Variables:
+// compile-command: "make -C .. unit-tests"
+// coding: utf-8-unix
+// c-basic-offset: 2
+// indent-tabs-mode: nil
+// End:
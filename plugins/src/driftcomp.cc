@@ -0,0 +1,52 @@
+#include "driftcomp.h"
+#include <math.h>
+
+// smallest weight of a new report in the drift estimate, i.e., the
+// drift is averaged over at least the last 1/DC_MIN_GAIN reports:
+#define DC_MIN_GAIN 0.002
+
+drift_compensator_t::drift_compensator_t(size_t channels, size_t blocksize,
+                                         double drift, double maxdrift)
+    : channels(channels), maxdrift(fabs(maxdrift)),
+      ratio(1.0 + std::max(-this->maxdrift, std::min(this->maxdrift, drift))),
+      fifo(4u * blocksize + 8u, channels),
+      resampler(channels, blocksize, this->maxdrift)
+{
+}
+
+void drift_compensator_t::update(const netaudio_report_t& report)
+{
+  // the reported drift is the residual after resampling, the drift
+  // of the sender clock is estimated as the mean of all reports:
+  double r(ratio);
+  double estimate(r * (1.0 + report.drift));
+  double gain(std::max(DC_MIN_GAIN, 1.0 / (1.0 + reports)));
+  ++reports;
+  r += gain * (estimate - r);
+  ratio = std::max(1.0 - maxdrift, std::min(1.0 + maxdrift, r));
+}
+
+void drift_compensator_t::write(const float* audio, size_t frames)
+{
+  fifo.write_data(audio, frames, channels, write_pos);
+  write_pos += frames;
+}
+
+bool drift_compensator_t::read(float* audio, size_t frames)
+{
+  double r(ratio);
+  // the resampler reads at most one frame more than frames * ratio:
+  if(fifo.rspace() < frames * r + 1.0)
+    return false;
+  resampler.read(fifo, audio, frames, r);
+  return true;
+}
+
+/*
+ * Local Variables:
+ * mode: c++
+ * c-basic-offset: 2
+ * indent-tabs-mode: nil
+ * compile-command: "make -C .."
+ * End:
+ */
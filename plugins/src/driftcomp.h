@@ -0,0 +1,86 @@
+/**
+ * @file driftcomp.h
+ * @brief Sender side compensation of clock drift
+ */
+
+#ifndef DRIFTCOMP_H
+#define DRIFTCOMP_H
+
+#include "netaudio.h"
+#include "resampler.h"
+#include "ringbuffer.h"
+#include <atomic>
+
+/**
+ * @brief Resample a stream at the sender to the clock of the receiver
+ *
+ * Blocks of the sender are written into a FIFO, and packets are read
+ * from it with a resampling ratio, so the number of packets per block
+ * varies with the ratio. The ratio is initialized with a known drift,
+ * e.g., measured against a reference clock. With receiver reports,
+ * it is replaced by the mean of the drift measured by the receiver,
+ * corrected by the ratio at the time of the report. Averaging many
+ * reports is required, since the rate measured by the receiver only
+ * changes when a packet is skipped or added. When a receiver plays
+ * the stream at its own clock, its jitter buffer then neither fills
+ * nor drains, without resampling at the receiver.
+ *
+ * update() is called by the thread which receives the reports, all
+ * other methods by the audio thread.
+ */
+class drift_compensator_t {
+public:
+  /**
+   * @param channels Number of channels
+   * @param blocksize Maximum number of frames per write
+   * @param drift Initial relative deviation of the sender clock from
+   * the receiver clock, positive if the sender clock is faster
+   * @param maxdrift Maximum deviation of the resampling ratio from one
+   */
+  drift_compensator_t(size_t channels, size_t blocksize, double drift = 0.0,
+                      double maxdrift = 0.001);
+  /**
+   * Update the ratio with a receiver report.
+   *
+   * @param report Receiver report of the resampled stream
+   */
+  void update(const netaudio_report_t& report);
+  /**
+   * Write a block of the sender.
+   *
+   * @param audio Interleaved audio samples
+   * @param frames Number of frames, at most blocksize
+   */
+  void write(const float* audio, size_t frames);
+  /**
+   * Read resampled frames for one packet, if available.
+   *
+   * @param audio Buffer for interleaved audio samples
+   * @param frames Number of frames, at most blocksize
+   * @return True if the frames were read, false if not enough frames
+   * were written yet
+   */
+  bool read(float* audio, size_t frames);
+  /// Resampling ratio, sender frames per transmitted frame
+  double get_ratio() const { return ratio; };
+
+private:
+  size_t channels;
+  double maxdrift;
+  std::atomic<double> ratio;
+  ringbuffer_ooowrite_t fifo;
+  resampler_t resampler;
+  uint64_t write_pos = 0;
+  size_t reports = 0;
+};
+
+#endif
+
+/*
+ * Local Variables:
+ * mode: c++
+ * c-basic-offset: 2
+ * indent-tabs-mode: nil
+ * compile-command: "make -C .."
+ * End:
+ */
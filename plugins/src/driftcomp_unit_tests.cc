@@ -0,0 +1,76 @@
+#include <gtest/gtest.h>
+
+#include "driftcomp.h"
+#include "receiver.h"
+#include <math.h>
+
+TEST(drift_compensator, fixed_ratio)
+{
+  const size_t blocksize(64);
+  drift_compensator_t comp(1, blocksize, 0.001);
+  EXPECT_DOUBLE_EQ(1.001, comp.get_ratio());
+  float in[blocksize];
+  float out[blocksize];
+  size_t frames_in(0);
+  size_t frames_out(0);
+  for(size_t n = 0; n < 10000; ++n) {
+    for(size_t k = 0; k < blocksize; ++k)
+      in[k] = sinf(0.01f * (frames_in + k));
+    comp.write(in, blocksize);
+    frames_in += blocksize;
+    while(comp.read(out, blocksize / 2))
+      frames_out += blocksize / 2;
+  }
+  // one output frame for every 1.001 input frames, except for the
+  // frames remaining in the FIFO:
+  EXPECT_NEAR(frames_in / 1.001, frames_out, 2.0 * blocksize);
+  // the ratio is limited:
+  drift_compensator_t limited(1, blocksize, 0.1, 0.001);
+  EXPECT_DOUBLE_EQ(1.001, limited.get_ratio());
+}
+
+TEST(drift_compensator, follow_reports)
+{
+  // the sender clock is 200 ppm faster than the receiver clock:
+  const double drift(2e-4);
+  const size_t blocksize(64);
+  const size_t fragsize(32);
+  const double srate(48000);
+  drift_compensator_t comp(1, blocksize);
+  netaudio_info_t info(new_netaudio_info(srate, pcm16bit, 1, fragsize));
+  ringbuffer_ooowrite_t rb(8192, 1);
+  netaudio_receiver_t receiver(rb);
+  char packet[1024];
+  netaudio_err_t err;
+  size_t len(encode_header(info, packet, sizeof(packet), err));
+  receiver.process_packet(packet, len, 0);
+  float in[blocksize] = {0};
+  float out[fragsize];
+  uint32_t sample_index(0);
+  uint64_t next_report(200000000ull);
+  // 60 seconds of sender blocks, arrival times on the receiver clock:
+  for(size_t n = 0; n < 45000; ++n) {
+    uint64_t t(1e9 * n * blocksize / (srate * (1.0 + drift)));
+    comp.write(in, blocksize);
+    while(comp.read(out, fragsize)) {
+      len = encode_audio(info, out, fragsize, sample_index, packet,
+                         sizeof(packet), err);
+      receiver.process_packet(packet, len, t);
+      sample_index += fragsize;
+    }
+    if(t >= next_report) {
+      netaudio_report_t report;
+      ASSERT_TRUE(receiver.get_report(report));
+      comp.update(report);
+      next_report += 200000000ull;
+    }
+  }
+  EXPECT_NEAR(1.0 + drift, comp.get_ratio(), 2e-5);
+}
+
+// Local Variables:
+// compile-command: "make -C .. unit-tests"
+// coding: utf-8-unix
+// c-basic-offset: 2
+// indent-tabs-mode: nil
+// End:
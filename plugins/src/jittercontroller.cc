@@ -0,0 +1,100 @@
+#include "jittercontroller.h"
+#include <algorithm>
+#include <math.h>
+
+// resolution of transit time histogram in seconds:
+#define JC_BINWIDTH 0.00025
+// time constants in seconds:
+#define JC_HISTOGRAM_TAU 10.0
+#define JC_BASELINE_TAU 10.0
+#define JC_LATE_TAU 10.0
+#define JC_DELAY_TAU 1.0
+#define JC_STEER_TAU 2.0
+// minimum observation time before the target is changed:
+#define JC_WARMUP 1.0
+// change of margin per late chunk, relative to chunk duration:
+#define JC_MARGIN_STEP 0.01
+
+jitter_controller_t::jitter_controller_t(double srate, double delay,
+                                         double mindelay, double maxdelay,
+                                         double maxloss, double maxstretch)
+    : srate(srate), mindelay(std::max(0.0, mindelay)),
+      maxdelay(std::max(this->mindelay, maxdelay)),
+      maxloss(std::max(0.0, std::min(0.5, maxloss))),
+      maxstretch(fabs(maxstretch)),
+      target(std::max(this->mindelay, std::min(this->maxdelay, delay))),
+      delay(delay), histogram(1u + (size_t)(this->maxdelay / JC_BINWIDTH))
+{
+}
+
+void jitter_controller_t::update(uint64_t timeline, uint32_t frames,
+                                 uint64_t read_pos, uint64_t arrival,
+                                 bool late)
+{
+  double duration(frames / srate);
+  if(!has_transit) {
+    timeline0 = timeline;
+    arrival0 = arrival;
+    has_transit = true;
+  }
+  // transit time relative to first chunk:
+  double transit(1e-9 * (double)(int64_t)(arrival - arrival0) -
+                 (double)(int64_t)(timeline - timeline0) / srate);
+  jitter = jitter + (fabs(transit - prev_transit) - jitter) / 16.0;
+  prev_transit = transit;
+  // the baseline follows the minimum transit time, and rises slowly
+  // to follow clock drift:
+  if((transit < baseline) || (transit - baseline > 4.0 * maxdelay))
+    baseline = transit;
+  else
+    baseline += (transit - baseline) * duration / JC_BASELINE_TAU;
+  double d(transit - baseline);
+  double forget(exp(-duration / JC_HISTOGRAM_TAU));
+  for(auto& h : histogram)
+    h *= forget;
+  histogram_sum *= forget;
+  histogram[std::min(histogram.size() - 1u, (size_t)(d / JC_BINWIDTH))] += 1.0;
+  histogram_sum += 1.0;
+  observed += duration;
+  // the margin settles where the rate of late chunks equals maxloss;
+  // it is not changed while the playout delay is far from the target,
+  // since late chunks are then expected:
+  if(fabs(delay - target) < JC_STEER_TAU * maxstretch) {
+    if(late)
+      margin += JC_MARGIN_STEP * duration;
+    else
+      margin -= JC_MARGIN_STEP * duration * maxloss / (1.0 - maxloss);
+    margin = std::max(-maxdelay, std::min(maxdelay, margin));
+  }
+  late_rate = late_rate + ((late ? 1.0 : 0.0) - late_rate) *
+                              std::min(1.0, duration / JC_LATE_TAU);
+  if(observed >= JC_WARMUP)
+    target = std::max(mindelay,
+                      std::min(maxdelay, quantile(1.0 - maxloss) + margin));
+  // playout delay of this chunk, without the transit time variation:
+  double current((double)(int64_t)(timeline - read_pos) / srate + d);
+  delay = delay + (current - delay) * std::min(1.0, duration / JC_DELAY_TAU);
+  ratio = 1.0 + std::max(-maxstretch,
+                         std::min(maxstretch, (delay - target) / JC_STEER_TAU));
+}
+
+double jitter_controller_t::quantile(double q) const
+{
+  double limit(q * histogram_sum);
+  double sum(0.0);
+  for(size_t k = 0; k < histogram.size(); ++k) {
+    sum += histogram[k];
+    if(sum >= limit)
+      return (k + 1u) * JC_BINWIDTH;
+  }
+  return histogram.size() * JC_BINWIDTH;
+}
+
+/*
+ * Local Variables:
+ * mode: c++
+ * c-basic-offset: 2
+ * indent-tabs-mode: nil
+ * compile-command: "make -C .."
+ * End:
+ */
@@ -0,0 +1,104 @@
+/**
+ * @file jittercontroller.h
+ * @brief Adaptive control of the jitter buffer playout delay
+ */
+
+#ifndef JITTERCONTROLLER_H
+#define JITTERCONTROLLER_H
+
+#include <atomic>
+#include <stdint.h>
+#include <vector>
+
+/**
+ * @brief Adapt the playout delay to the network conditions
+ *
+ * The transit time of audio chunks, i.e., the arrival time relative
+ * to the position on the sample timeline, is measured for every
+ * chunk. The target delay is the quantile of the transit time
+ * variation which is expected to give the tolerated rate of late
+ * chunks. It is corrected by the measured late chunk rate, to
+ * compensate for effects which are not visible in the transit time,
+ * e.g., the block processing on the playout side.
+ *
+ * The playout delay is changed smoothly by a resampling ratio
+ * slightly above or below one (see resampler_t), rather than by
+ * dropping or inserting samples. This also compensates for clock
+ * drift between sender and receiver.
+ *
+ * update() is called by the receiving thread, the getters may be
+ * called by any thread.
+ */
+class jitter_controller_t {
+public:
+  /**
+   * @param srate Sampling rate of the sample timeline in Hz
+   * @param delay Initial playout delay in seconds
+   * @param mindelay Minimum playout delay in seconds
+   * @param maxdelay Maximum playout delay in seconds
+   * @param maxloss Tolerated rate of late chunks, between 0 and 1:
+   * lower values result in higher latency
+   * @param maxstretch Maximum deviation of resampling ratio from one
+   */
+  jitter_controller_t(double srate, double delay, double mindelay,
+                      double maxdelay, double maxloss,
+                      double maxstretch = 0.005);
+  /**
+   * Update the measurements with a new audio chunk.
+   *
+   * @param timeline Timeline position of the chunk
+   * @param frames Number of frames in chunk
+   * @param read_pos Current read position of the jitter buffer
+   * @param arrival Arrival time in nanoseconds
+   * @param late True if frames of the chunk were too late for playout
+   */
+  void update(uint64_t timeline, uint32_t frames, uint64_t read_pos,
+              uint64_t arrival, bool late);
+  /// Resampling ratio, input frames per output frame
+  double get_ratio() const { return ratio; };
+  /// Target playout delay in seconds
+  double get_target() const { return target; };
+  /// Smoothed current playout delay in seconds
+  double get_delay() const { return delay; };
+  /// Interarrival jitter in seconds, as defined in RFC 3550
+  double get_jitter() const { return jitter; };
+  /// Smoothed rate of late chunks
+  double get_late_rate() const { return late_rate; };
+
+private:
+  double quantile(double q) const;
+  double srate;
+  double mindelay;
+  double maxdelay;
+  double maxloss;
+  double maxstretch;
+  std::atomic<double> ratio = 1.0;
+  std::atomic<double> target;
+  std::atomic<double> delay;
+  std::atomic<double> jitter = 0.0;
+  std::atomic<double> late_rate = 0.0;
+  bool has_transit = false;
+  uint64_t timeline0 = 0;
+  uint64_t arrival0 = 0;
+  double prev_transit = 0.0;
+  // lower envelope of transit time:
+  double baseline = 0.0;
+  // correction from late chunk rate:
+  double margin = 0.0;
+  // histogram of transit time variation, with forgetting:
+  std::vector<double> histogram;
+  double histogram_sum = 0.0;
+  // observed duration covered by the histogram:
+  double observed = 0.0;
+};
+
+#endif
+
+/*
+ * Local Variables:
+ * mode: c++
+ * c-basic-offset: 2
+ * indent-tabs-mode: nil
+ * compile-command: "make -C .."
+ * End:
+ */
@@ -0,0 +1,91 @@
+#include <gtest/gtest.h>
+
+#include "jittercontroller.h"
+#include "netaudio.h"
+#include "receiver.h"
+#include "resampler.h"
+#include <algorithm>
+#include <random>
+
+// Stream chunks with uniformly distributed transit time variation
+// through receiver, jitter buffer and resampler for the given
+// duration, and count the chunks which were too late.
+static void simulate(jitter_controller_t& controller, double jitter,
+                     double duration, size_t& late_chunks)
+{
+  const size_t fragsize(64);
+  const double srate(48000);
+  netaudio_info_t info(new_netaudio_info(srate, pcmfloat, 1, fragsize));
+  ringbuffer_ooowrite_t rb(8192, 1, 0.001 * controller.get_target() * srate);
+  netaudio_receiver_t receiver(rb);
+  receiver.set_controller(&controller);
+  resampler_t resampler(1, fragsize);
+  std::mt19937 gen(1);
+  std::uniform_real_distribution<double> dist(0.0, jitter);
+  // packets sorted by arrival time:
+  std::vector<std::pair<uint64_t, std::vector<char>>> packets;
+  float audio[fragsize] = {0};
+  netaudio_err_t err;
+  std::vector<char> header(get_buffer_length_header());
+  encode_header(info, header.data(), header.size(), err);
+  packets.push_back({0, header});
+  size_t nchunks(duration * srate / fragsize);
+  for(size_t n = 0; n < nchunks; ++n) {
+    std::vector<char> packet(get_buffer_length(info));
+    encode_audio(info, audio, fragsize, n * fragsize, packet.data(),
+                 packet.size(), err);
+    uint64_t t(1e9 * ((n + 1) * fragsize / srate + dist(gen)));
+    packets.push_back({t, packet});
+  }
+  std::stable_sort(
+      packets.begin(), packets.end(),
+      [](const auto& a, const auto& b) { return a.first < b.first; });
+  double t_play(1e9 * fragsize / srate);
+  size_t late_frames(0);
+  late_chunks = 0;
+  for(auto& p : packets) {
+    while(t_play <= p.first) {
+      resampler.read(rb, audio, fragsize, controller.get_ratio());
+      t_play += 1e9 * fragsize / srate;
+    }
+    receiver.process_packet(p.second.data(), p.second.size(), p.first);
+    if(rb.get_late_frames() != late_frames)
+      ++late_chunks;
+    late_frames = rb.get_late_frames();
+  }
+}
+
+TEST(jittercontroller, shrink)
+{
+  jitter_controller_t controller(48000, 0.02, 0.001, 0.1, 0.01);
+  EXPECT_EQ(0.02, controller.get_target());
+  EXPECT_EQ(1.0, controller.get_ratio());
+  size_t late_chunks(0);
+  simulate(controller, 0.0005, 30.0, late_chunks);
+  EXPECT_GT(0.005, controller.get_target());
+  EXPECT_NEAR(controller.get_target(), controller.get_delay(), 0.002);
+  EXPECT_NEAR(0.00025, controller.get_jitter(), 0.0001);
+  EXPECT_GT(0.01, controller.get_late_rate());
+  EXPECT_GT(450u, late_chunks);
+}
+
+TEST(jittercontroller, grow)
+{
+  jitter_controller_t controller(48000, 0.002, 0.001, 0.1, 0.01);
+  size_t late_chunks(0);
+  simulate(controller, 0.01, 30.0, late_chunks);
+  EXPECT_LT(0.009, controller.get_target());
+  EXPECT_GT(0.02, controller.get_target());
+  EXPECT_NEAR(controller.get_target(), controller.get_delay(), 0.002);
+  EXPECT_GT(0.03, controller.get_late_rate());
+  // ratio is limited:
+  EXPECT_GE(1.005, controller.get_ratio());
+  EXPECT_LE(0.995, controller.get_ratio());
+}
+
+// Local Variables:
+// compile-command: "make -C .. unit-tests"
+// coding: utf-8-unix
+// c-basic-offset: 2
+// indent-tabs-mode: nil
+// End:
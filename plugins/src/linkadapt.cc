@@ -0,0 +1,58 @@
+#include "linkadapt.h"
+
+// minimum time between changes towards more robust configurations:
+#define LA_HOLD_NS 2000000000ull
+// time with low loss before a preferred configuration is tried again:
+#define LA_RECOVER_NS 10000000000ull
+// loss rate relative to maxloss which is considered low:
+#define LA_LOW_LOSS 0.25
+
+link_adapter_t::link_adapter_t(samplefmt_t samplefmt, uint32_t fragsize,
+                               uint32_t channels, double maxloss, size_t mtu)
+    : maxloss(maxloss)
+{
+  levels.push_back({samplefmt, fragsize});
+  if(samplefmt == pcmfloat)
+    levels.push_back({pcm16bit, fragsize});
+  while((fragsize % 2u == 0u) &&
+        (get_buffer_length(new_netaudio_info(1, pcm16bit, channels,
+                                             fragsize)) > mtu)) {
+    fragsize /= 2u;
+    levels.push_back({pcm16bit, fragsize});
+  }
+}
+
+bool link_adapter_t::update(const netaudio_report_t& report, uint64_t now)
+{
+  if(!has_time) {
+    last_change = now;
+    good_since = now;
+    has_time = true;
+  }
+  if(report.loss >= LA_LOW_LOSS * maxloss)
+    good_since = now;
+  size_t l(level);
+  if((report.loss > maxloss) && (l + 1u < levels.size()) &&
+     (now - last_change >= LA_HOLD_NS)) {
+    level = l + 1u;
+    last_change = now;
+    return true;
+  }
+  if((l > 0u) && (now - good_since >= LA_RECOVER_NS) &&
+     (now - last_change >= LA_RECOVER_NS)) {
+    level = l - 1u;
+    last_change = now;
+    good_since = now;
+    return true;
+  }
+  return false;
+}
+
+/*
+ * Local Variables:
+ * mode: c++
+ * c-basic-offset: 2
+ * indent-tabs-mode: nil
+ * compile-command: "make -C .."
+ * End:
+ */
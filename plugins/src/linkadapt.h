@@ -0,0 +1,84 @@
+/**
+ * @file linkadapt.h
+ * @brief Adaptation of the stream configuration to receiver reports
+ */
+
+#ifndef LINKADAPT_H
+#define LINKADAPT_H
+
+#include "netaudio.h"
+#include <atomic>
+#include <vector>
+
+/**
+ * @brief Sample format and packet size of a stream
+ */
+struct link_config_t {
+  samplefmt_t samplefmt;
+  uint32_t fragsize; ///< frames per packet
+};
+
+/**
+ * @brief Choose sample format and packet size from reception quality
+ *
+ * The possible stream configurations are ordered from the preferred
+ * one to the most robust one: first the sample format is reduced from
+ * pcmfloat to pcm16bit, then the number of frames per packet is
+ * halved until the packets fit into the MTU, to avoid IP
+ * fragmentation, where the loss of one fragment loses the whole
+ * packet. The number of frames per packet always divides the block
+ * size of the sender.
+ *
+ * If the reported loss rate exceeds the tolerated loss, the next
+ * more robust configuration is selected, at most once per hold
+ * time. After a longer period of low loss, the next preferred
+ * configuration is tried again.
+ *
+ * update() is called by the thread which receives the reports, the
+ * getters may be called by any thread.
+ */
+class link_adapter_t {
+public:
+  /**
+   * @param samplefmt Preferred sample format
+   * @param fragsize Block size of the sender in frames
+   * @param channels Number of channels
+   * @param maxloss Tolerated loss rate, between 0 and 1
+   * @param mtu Largest packet size in bytes which is not fragmented
+   */
+  link_adapter_t(samplefmt_t samplefmt, uint32_t fragsize, uint32_t channels,
+                 double maxloss = 0.02, size_t mtu = 1472);
+  /**
+   * Update with a receiver report.
+   *
+   * @param report Receiver report of the current configuration
+   * @param now Time of monotonic clock in nanoseconds
+   * @return True if the configuration has changed
+   */
+  bool update(const netaudio_report_t& report, uint64_t now);
+  /// Current configuration
+  link_config_t get_config() const { return levels[level]; };
+  /// Index of the current configuration, zero is the preferred one
+  size_t get_level() const { return level; };
+  /// Number of configurations
+  size_t get_num_levels() const { return levels.size(); };
+
+private:
+  std::vector<link_config_t> levels;
+  double maxloss;
+  std::atomic<size_t> level = 0;
+  bool has_time = false;
+  uint64_t last_change = 0;
+  uint64_t good_since = 0;
+};
+
+#endif
+
+/*
+ * Local Variables:
+ * mode: c++
+ * c-basic-offset: 2
+ * indent-tabs-mode: nil
+ * compile-command: "make -C .."
+ * End:
+ */
@@ -0,0 +1,64 @@
+#include <gtest/gtest.h>
+
+#include "linkadapt.h"
+
+TEST(link_adapter, levels)
+{
+  // 8 channels of 256 frames are 8 kB in float, and need to be
+  // reduced to 64 frames in pcm16bit to fit into the MTU:
+  link_adapter_t adapter(pcmfloat, 256, 8);
+  ASSERT_EQ(4u, adapter.get_num_levels());
+  EXPECT_EQ(pcmfloat, adapter.get_config().samplefmt);
+  EXPECT_EQ(256u, adapter.get_config().fragsize);
+  // small packets of the preferred format have no alternative:
+  link_adapter_t small(pcm16bit, 64, 2);
+  EXPECT_EQ(1u, small.get_num_levels());
+  // odd block sizes can not be split:
+  link_adapter_t odd(pcm16bit, 1023, 2);
+  EXPECT_EQ(1u, odd.get_num_levels());
+}
+
+TEST(link_adapter, update)
+{
+  const uint64_t second(1000000000ull);
+  link_adapter_t adapter(pcmfloat, 256, 8, 0.02);
+  netaudio_report_t report;
+  report.loss = 0.1f;
+  uint64_t t(0);
+  // loss reports every 200 ms degrade the configuration every 2 s:
+  EXPECT_FALSE(adapter.update(report, t));
+  for(size_t k = 0; k < 10; ++k) {
+    t += second / 5;
+    adapter.update(report, t);
+  }
+  EXPECT_EQ(1u, adapter.get_level());
+  EXPECT_EQ(pcm16bit, adapter.get_config().samplefmt);
+  EXPECT_EQ(256u, adapter.get_config().fragsize);
+  for(size_t k = 0; k < 100; ++k) {
+    t += second / 5;
+    adapter.update(report, t);
+  }
+  EXPECT_EQ(3u, adapter.get_level());
+  EXPECT_EQ(64u, adapter.get_config().fragsize);
+  // moderate loss keeps the configuration:
+  report.loss = 0.01f;
+  for(size_t k = 0; k < 100; ++k) {
+    t += second / 5;
+    EXPECT_FALSE(adapter.update(report, t));
+  }
+  // low loss for 10 s recovers one step:
+  report.loss = 0.0f;
+  for(size_t k = 0; k < 50; ++k) {
+    t += second / 5;
+    adapter.update(report, t);
+  }
+  EXPECT_EQ(2u, adapter.get_level());
+  EXPECT_EQ(128u, adapter.get_config().fragsize);
+}
+
+// Local Variables:
+// compile-command: "make -C .. unit-tests"
+// coding: utf-8-unix
+// c-basic-offset: 2
+// indent-tabs-mode: nil
+// End:
@@ -1,8 +1,12 @@
 #include "netaudio.h"
+#include "netaudio_codec.h"
+#include "netaudio_wire.h"
+#include <algorithm>
+#include <math.h>
 #include <string.h>
 
-#define NETAUDIO_HEADER '\001'
-#define NETAUDIO_AUDIO '\002'
+// number of channels scanned at once for silent channels:
+#define PEAKSCAN_BLOCK 64
 
 #define CRC16 0x8005
 
@@ -76,18 +80,46 @@ uint32_t gen_crc32b(const uint8_t* data, uint16_t size)
   return ~crc;
 }
 
+// serialize all fields of an info structure into a header package:
+static void store_info(const netaudio_info_t& info, char* data)
+{
+  store_le16(&(data[netaudio_hdr_id]), info.id);
+  store_le16(&(data[netaudio_hdr_samplefmt]), info.samplefmt);
+  store_lefloat(&(data[netaudio_hdr_srate]), info.srate);
+  store_le16(&(data[netaudio_hdr_channels]), info.channels);
+  store_le16(&(data[netaudio_hdr_fragsize]), info.fragsize);
+  store_le32(&(data[netaudio_hdr_chksum]), info.chksum);
+}
+
+static void load_info(netaudio_info_t& info, const char* data)
+{
+  info.id = load_le16(&(data[netaudio_hdr_id]));
+  info.samplefmt = (samplefmt_t)load_le16(&(data[netaudio_hdr_samplefmt]));
+  info.srate = load_lefloat(&(data[netaudio_hdr_srate]));
+  info.channels = load_le16(&(data[netaudio_hdr_channels]));
+  info.fragsize = load_le16(&(data[netaudio_hdr_fragsize]));
+  info.chksum = load_le32(&(data[netaudio_hdr_chksum]));
+}
+
 uint32_t get_checksum(netaudio_info_t info)
 {
+  // the checksum is computed on the little-endian representation,
+  // which is identical to the memory layout of protocol version 1 on
+  // little-endian hosts:
   info.chksum = 0;
-  return gen_crc32b((uint8_t*)(&info), sizeof(info));
+  char data[netaudio_hdr_size];
+  store_info(info, data);
+  return gen_crc32b((uint8_t*)(&(data[netaudio_hdr_id])),
+                    sizeof(netaudio_info_t));
 }
 
 netaudio_info_t new_netaudio_info(double srate, samplefmt_t samplefmt,
-                                  uint16_t channels, uint32_t fragsize)
+                                  uint16_t channels, uint32_t fragsize,
+                                  uint16_t id)
 {
   netaudio_info_t info;
   memset(&info, 0, sizeof(info));
-  info.id = 1;
+  info.id = id;
   info.srate = srate;
   info.samplefmt = samplefmt;
   info.channels = channels;
@@ -108,15 +140,44 @@ size_t encode_header(const netaudio_info_t& info, char* data, size_t len,
     return 0u;
   }
   // mark data block to be a header:
-  data[0] = NETAUDIO_HEADER;
-  memcpy(&(data[1]), &info, sizeof(netaudio_info_t));
+  data[netaudio_hdr_type] = NETAUDIO_HEADER;
+  store_info(info, data);
   err = netaudio_success;
-  return sizeof(netaudio_info_t) + 1;
+  return netaudio_hdr_size;
 }
 
 size_t get_buffer_length_header()
 {
-  return sizeof(netaudio_info_t) + 1;
+  return netaudio_hdr_size;
+}
+
+size_t get_buffer_length_report()
+{
+  return netaudio_report_size;
+}
+
+static size_t get_sample_size(samplefmt_t samplefmt)
+{
+  switch(samplefmt) {
+  case pcm16bit:
+    return sizeof(int16_t);
+  case pcmfloat:
+    return sizeof(float);
+  }
+  return 0u;
+}
+
+// validate a stream configuration received from the network:
+static netaudio_err_t check_limits(const netaudio_info_t& info)
+{
+  if(!get_sample_size(info.samplefmt))
+    return netaudio_unsupported_sample_format;
+  if((info.channels < 1u) || (info.channels > NETAUDIO_MAX_CHANNELS) ||
+     (info.fragsize < 1u) || (info.fragsize > NETAUDIO_MAX_FRAGSIZE) ||
+     !(info.srate > 0.0f) || !(info.srate <= NETAUDIO_MAX_SRATE) ||
+     (get_buffer_length(info) > NETAUDIO_MAX_PACKET_SIZE))
+    return netaudio_limits_exceeded;
+  return netaudio_success;
 }
 
 size_t decode_header(netaudio_info_t& info, const char* data, size_t len,
@@ -126,32 +187,75 @@ size_t decode_header(netaudio_info_t& info, const char* data, size_t len,
     err = netaudio_invalid_pointer;
     return 0u;
   }
-  if(len < sizeof(netaudio_info_t) + 1) {
+  if(len < netaudio_hdr_size) {
     err = netaudio_insufficient_memory;
     return 0u;
   }
-  if(data[0] != NETAUDIO_HEADER) {
+  if(data[netaudio_hdr_type] != NETAUDIO_HEADER) {
     err = netaudio_not_a_header;
     return 0u;
   }
   netaudio_info_t newinfo;
-  memcpy(&newinfo, &(data[1]), sizeof(netaudio_info_t));
+  load_info(newinfo, data);
   if(get_checksum(newinfo) != newinfo.chksum) {
     err = netaudio_invalid_checksum;
     return 0u;
   }
-  if(1 != newinfo.id) {
+  if((1 != newinfo.id) && (2 != newinfo.id)) {
     err = netaudio_unsupported_protocol_version;
     return 0u;
   }
+  err = check_limits(newinfo);
+  if(err != netaudio_success)
+    return 0u;
   info = newinfo;
   err = netaudio_success;
-  return sizeof(netaudio_info_t) + 1;
+  return netaudio_hdr_size;
 }
 
-size_t encode_audio(const netaudio_info_t& info, const float* audio,
-                    size_t num_elem, uint32_t sample_index, char* data,
-                    size_t len, netaudio_err_t& err)
+// Scan all channels for their peak value and mark channels which are
+// not silent in the channel mask. The inner loop is over contiguous
+// channels of one frame, which is vectorized by the compiler.
+static size_t scan_active_channels(const netaudio_info_t& info,
+                                   const float* audio, char* mask)
+{
+  const size_t channels(info.channels);
+  size_t nactive(0);
+  memset(mask, 0, (channels + 7u) / 8u);
+  for(size_t c0 = 0; c0 < channels; c0 += PEAKSCAN_BLOCK) {
+    const size_t nch(std::min((size_t)PEAKSCAN_BLOCK, channels - c0));
+    float peak[PEAKSCAN_BLOCK];
+    for(size_t c = 0; c < nch; ++c)
+      peak[c] = 0.0f;
+    for(size_t k = 0; k < info.fragsize; ++k) {
+      const float* frame(&(audio[channels * k + c0]));
+      for(size_t c = 0; c < nch; ++c)
+        peak[c] = std::max(peak[c], fabsf(frame[c]));
+    }
+    for(size_t c = 0; c < nch; ++c) {
+      bool active(false);
+      switch(info.samplefmt) {
+      case pcm16bit:
+        // the encoder rounds, i.e., channels are omitted only if all
+        // samples are encoded as zero:
+        active = peak[c] * ((1 << 15) - 1) >= 0.5f;
+        break;
+      case pcmfloat:
+        active = peak[c] > 0.0f;
+        break;
+      }
+      if(active) {
+        mask[(c0 + c) / 8u] |= (char)(1u << ((c0 + c) % 8u));
+        ++nactive;
+      }
+    }
+  }
+  return nactive;
+}
+
+size_t encode_audio_sparse(const netaudio_info_t& info, const float* audio,
+                           size_t num_elem, uint32_t sample_index, char* data,
+                           size_t len, netaudio_err_t& err)
 {
   if(!audio) {
     err = netaudio_invalid_pointer;
@@ -165,28 +269,193 @@ size_t encode_audio(const netaudio_info_t& info, const float* audio,
     err = netaudio_invalid_buffer_dimensions;
     return 0u;
   }
-  size_t requiredlen(get_buffer_length(info));
+  const size_t samplesize(get_sample_size(info.samplefmt));
+  if(!samplesize) {
+    err = netaudio_unsupported_sample_format;
+    return 0u;
+  }
+  size_t fulllen(get_buffer_length(info));
+  if(len < fulllen) {
+    err = netaudio_insufficient_memory;
+    return 0u;
+  }
+  const size_t maskbytes((info.channels + 7u) / 8u);
+  char* mask(&(data[netaudio_audio_data]));
+  const size_t nactive(scan_active_channels(info, audio, mask));
+  const size_t requiredlen(netaudio_audio_data + maskbytes +
+                           nactive * info.fragsize * samplesize);
+  if(requiredlen >= fulllen)
+    return encode_audio(info, audio, num_elem, sample_index, data, len, err);
+  data[netaudio_audio_type] = NETAUDIO_AUDIO_SPARSE;
+  store_le32(&(data[netaudio_audio_chksum]), info.chksum);
+  store_le32(&(data[netaudio_audio_sampleindex]), sample_index);
+  data += netaudio_audio_data + maskbytes;
+  for(size_t k = 0; k < info.fragsize; ++k) {
+    const float* frame(&(audio[info.channels * k]));
+    for(size_t c = 0; c < info.channels; ++c) {
+      if(!(mask[c / 8u] & (1u << (c % 8u))))
+        continue;
+      switch(info.samplefmt) {
+      case pcm16bit:
+        netaudio_sample_t<pcm16bit>::encode(data, frame[c]);
+        break;
+      case pcmfloat:
+        netaudio_sample_t<pcmfloat>::encode(data, frame[c]);
+        break;
+      }
+      data += samplesize;
+    }
+  }
+  err = netaudio_success;
+  return requiredlen;
+}
+
+static size_t decode_audio_sparse(const netaudio_info_t& info, float* audio,
+                                  uint32_t& sample_index, const char* data,
+                                  size_t len, size_t first, size_t last,
+                                  netaudio_err_t& err)
+{
+  const size_t maskbytes((info.channels + 7u) / 8u);
+  if(len < netaudio_audio_data + maskbytes) {
+    err = netaudio_insufficient_memory;
+    return 0u;
+  }
+  const char* mask(&(data[netaudio_audio_data]));
+  size_t nactive(0);
+  // active channels preceding the decoded range:
+  size_t nbefore(0);
+  for(size_t c = 0; c < info.channels; ++c)
+    if(mask[c / 8u] & (1u << (c % 8u))) {
+      ++nactive;
+      if(c < first)
+        ++nbefore;
+    }
+  const size_t samplesize(get_sample_size(info.samplefmt));
+  const size_t requiredlen(netaudio_audio_data + maskbytes +
+                           nactive * info.fragsize * samplesize);
   if(len < requiredlen) {
     err = netaudio_insufficient_memory;
     return 0u;
   }
-  data[0] = NETAUDIO_AUDIO;
-  memcpy(&(data[1]), &(info.chksum), sizeof(info.chksum));
-  data += 1 + sizeof(info.chksum);
-  memcpy(data,&sample_index,sizeof(uint32_t));
-  data += 4u;
+  if(load_le32(&(data[netaudio_audio_chksum])) != info.chksum) {
+    err = netaudio_invalid_checksum;
+    return 0u;
+  }
+  sample_index = load_le32(&(data[netaudio_audio_sampleindex]));
+  data += netaudio_audio_data + maskbytes;
+  for(size_t k = 0; k < info.fragsize; ++k) {
+    float* frame(&(audio[info.channels * k]));
+    const char* next(data + nactive * samplesize);
+    data += nbefore * samplesize;
+    for(size_t c = first; c < last; ++c) {
+      if(!(mask[c / 8u] & (1u << (c % 8u)))) {
+        frame[c] = 0.0f;
+        continue;
+      }
+      switch(info.samplefmt) {
+      case pcm16bit:
+        frame[c] = netaudio_sample_t<pcm16bit>::decode(data);
+        break;
+      case pcmfloat:
+        frame[c] = netaudio_sample_t<pcmfloat>::decode(data);
+        break;
+      }
+      data += samplesize;
+    }
+    data = next;
+  }
+  err = netaudio_success;
+  return requiredlen;
+}
+
+// conversion functions for one sample format, specialized for
+// common channel counts, the last entry is for any channel count:
+struct codec_table_entry_t {
+  size_t channels;
+  void (*encode)(const float*, size_t, size_t, char*);
+  void (*decode)(const char*, size_t, size_t, float*);
+};
+
+#define CODEC_ENTRY(fmt, channels)                                             \
+  {                                                                            \
+    channels, &encode_samples<fmt, channels>, &decode_samples<fmt, channels>   \
+  }
+
+#define CODEC_TABLE(fmt)                                                       \
+  {                                                                            \
+    CODEC_ENTRY(fmt, 1), CODEC_ENTRY(fmt, 2), CODEC_ENTRY(fmt, 8),             \
+        CODEC_ENTRY(fmt, 16), CODEC_ENTRY(fmt, 32), CODEC_ENTRY(fmt, 64),      \
+        CODEC_ENTRY(fmt, 0)                                                    \
+  }
+
+static const codec_table_entry_t codec_table_pcm16bit[] =
+    CODEC_TABLE(pcm16bit);
+static const codec_table_entry_t codec_table_pcmfloat[] =
+    CODEC_TABLE(pcmfloat);
+
+netaudio_codec_t new_netaudio_codec(const netaudio_info_t& info)
+{
+  netaudio_codec_t codec;
+  codec.info = info;
+  codec.encode = NULL;
+  codec.decode = NULL;
+  const codec_table_entry_t* entry(NULL);
   switch(info.samplefmt) {
   case pcm16bit:
-    for(size_t k = 0; k < num_elem; ++k) {
-      int16_t v(audio[k] * ((1 << 15) - 1));
-      memcpy(data, &v, sizeof(int16_t));
-      data += sizeof(int16_t);
-    }
+    entry = codec_table_pcm16bit;
     break;
   case pcmfloat:
-    memcpy(data, audio, sizeof(float) * num_elem);
+    entry = codec_table_pcmfloat;
     break;
   }
+  if(!entry)
+    return codec;
+  while(entry->channels && (entry->channels != info.channels))
+    ++entry;
+  codec.encode = entry->encode;
+  codec.decode = entry->decode;
+  return codec;
+}
+
+size_t encode_audio(const netaudio_info_t& info, const float* audio,
+                    size_t num_elem, uint32_t sample_index, char* data,
+                    size_t len, netaudio_err_t& err)
+{
+  return encode_audio(new_netaudio_codec(info), audio, num_elem, sample_index,
+                      data, len, err);
+}
+
+size_t encode_audio(const netaudio_codec_t& codec, const float* audio,
+                    size_t num_elem, uint32_t sample_index, char* data,
+                    size_t len, netaudio_err_t& err)
+{
+  const netaudio_info_t& info(codec.info);
+  if(!audio) {
+    err = netaudio_invalid_pointer;
+    return 0u;
+  }
+  if(!data) {
+    err = netaudio_invalid_pointer;
+    return 0u;
+  }
+  if(num_elem != info.fragsize * info.channels) {
+    err = netaudio_invalid_buffer_dimensions;
+    return 0u;
+  }
+  if(!codec.encode) {
+    err = netaudio_unsupported_sample_format;
+    return 0u;
+  }
+  size_t requiredlen(get_buffer_length(info));
+  if(len < requiredlen) {
+    err = netaudio_insufficient_memory;
+    return 0u;
+  }
+  data[netaudio_audio_type] = NETAUDIO_AUDIO;
+  store_le32(&(data[netaudio_audio_chksum]), info.chksum);
+  store_le32(&(data[netaudio_audio_sampleindex]), sample_index);
+  codec.encode(audio, info.fragsize, info.channels,
+               &(data[netaudio_audio_data]));
   err = netaudio_success;
   return requiredlen;
 }
@@ -195,6 +464,24 @@ size_t decode_audio(const netaudio_info_t& info, float* audio, size_t num_elem,
                     uint32_t& sample_index, const char* data, size_t len,
                     netaudio_err_t& err)
 {
+  return decode_audio(new_netaudio_codec(info), audio, num_elem, sample_index,
+                      data, len, err);
+}
+
+size_t decode_audio(const netaudio_codec_t& codec, float* audio,
+                    size_t num_elem, uint32_t& sample_index, const char* data,
+                    size_t len, netaudio_err_t& err)
+{
+  return decode_audio_channels(codec, audio, num_elem, sample_index, data, len,
+                               0u, codec.info.channels, err);
+}
+
+size_t decode_audio_channels(const netaudio_codec_t& codec, float* audio,
+                             size_t num_elem, uint32_t& sample_index,
+                             const char* data, size_t len, size_t first,
+                             size_t last, netaudio_err_t& err)
+{
+  const netaudio_info_t& info(codec.info);
   if(!audio) {
     err = netaudio_invalid_pointer;
     return 0u;
@@ -203,57 +490,117 @@ size_t decode_audio(const netaudio_info_t& info, float* audio, size_t num_elem,
     err = netaudio_invalid_pointer;
     return 0u;
   }
-  if(num_elem != info.fragsize * info.channels) {
+  if(len > NETAUDIO_MAX_PACKET_SIZE) {
+    err = netaudio_limits_exceeded;
+    return 0u;
+  }
+  err = check_limits(info);
+  if(err != netaudio_success)
+    return 0u;
+  if((num_elem != info.fragsize * info.channels) || (first > last) ||
+     (last > info.channels)) {
     err = netaudio_invalid_buffer_dimensions;
     return 0u;
   }
+  if(!codec.decode) {
+    err = netaudio_generic_error;
+    return 0u;
+  }
+  if(len && (data[netaudio_audio_type] == NETAUDIO_AUDIO_SPARSE))
+    return decode_audio_sparse(info, audio, sample_index, data, len, first,
+                               last, err);
   size_t requiredlen(get_buffer_length(info));
   if(len < requiredlen) {
     err = netaudio_insufficient_memory;
     return 0u;
   }
-  if(data[0] != NETAUDIO_AUDIO) {
+  if(data[netaudio_audio_type] != NETAUDIO_AUDIO) {
     err = netaudio_no_audiochunk;
     return 0u;
   }
-  uint32_t chksum;
-  memcpy(&chksum, &(data[1]), sizeof(chksum));
-  if(chksum != info.chksum) {
+  if(load_le32(&(data[netaudio_audio_chksum])) != info.chksum) {
     err = netaudio_invalid_checksum;
     return 0u;
   }
-  data += 1 + sizeof(chksum);
-  memcpy(&sample_index,data,sizeof(uint32_t));
-  data += 4u;
-  switch(info.samplefmt) {
-  case pcm16bit:
-    for(size_t k = 0; k < num_elem; ++k) {
-      int16_t v;
-      memcpy(&v, data, sizeof(int16_t));
-      audio[k] = v * (1.0f / ((1 << 15) - 1));
-      data += sizeof(int16_t);
-    }
-    break;
-  case pcmfloat:
-    memcpy(audio, data, sizeof(float) * num_elem);
-    break;
-  }
+  sample_index = load_le32(&(data[netaudio_audio_sampleindex]));
+  if((first == 0u) && (last == info.channels))
+    codec.decode(&(data[netaudio_audio_data]), info.fragsize, info.channels,
+                 audio);
+  else if(info.samplefmt == pcm16bit)
+    decode_channels<pcm16bit>(&(data[netaudio_audio_data]), info.fragsize,
+                              info.channels, first, last, audio);
+  else
+    decode_channels<pcmfloat>(&(data[netaudio_audio_data]), info.fragsize,
+                              info.channels, first, last, audio);
   err = netaudio_success;
   return requiredlen;
 }
 
-size_t get_buffer_length(const netaudio_info_t& info)
+size_t encode_report(const netaudio_report_t& report, char* data, size_t len,
+                     netaudio_err_t& err)
 {
-  size_t requiredlen;
-  switch(info.samplefmt) {
-  case pcm16bit:
-    requiredlen = info.channels * info.fragsize * sizeof(int16_t);
-    break;
-  case pcmfloat:
-    requiredlen = info.channels * info.fragsize * sizeof(float);
-    break;
+  if(!data) {
+    err = netaudio_invalid_pointer;
+    return 0u;
   }
-  return requiredlen + 1 + sizeof(info.chksum) + 4;
+  if(len < netaudio_report_size) {
+    err = netaudio_insufficient_memory;
+    return 0u;
+  }
+  data[netaudio_report_type] = NETAUDIO_REPORT;
+  store_le32(&(data[netaudio_report_chksum]), report.chksum);
+  store_le32(&(data[netaudio_report_sampleindex]), report.sample_index);
+  store_lefloat(&(data[netaudio_report_loss]), report.loss);
+  store_lefloat(&(data[netaudio_report_jitter]), report.jitter);
+  store_lefloat(&(data[netaudio_report_buffer]), report.buffer);
+  store_lefloat(&(data[netaudio_report_drift]), report.drift);
+  err = netaudio_success;
+  return netaudio_report_size;
+}
+
+size_t decode_report(netaudio_report_t& report, const char* data, size_t len,
+                     netaudio_err_t& err)
+{
+  if(!data) {
+    err = netaudio_invalid_pointer;
+    return 0u;
+  }
+  if(len < netaudio_report_size) {
+    err = netaudio_insufficient_memory;
+    return 0u;
+  }
+  if(data[netaudio_report_type] != NETAUDIO_REPORT) {
+    err = netaudio_not_a_report;
+    return 0u;
+  }
+  report.chksum = load_le32(&(data[netaudio_report_chksum]));
+  report.sample_index = load_le32(&(data[netaudio_report_sampleindex]));
+  report.loss = load_lefloat(&(data[netaudio_report_loss]));
+  report.jitter = load_lefloat(&(data[netaudio_report_jitter]));
+  report.buffer = load_lefloat(&(data[netaudio_report_buffer]));
+  report.drift = load_lefloat(&(data[netaudio_report_drift]));
+  err = netaudio_success;
+  return netaudio_report_size;
+}
+
+int32_t sample_index_diff(uint32_t a, uint32_t b)
+{
+  uint32_t d(a - b);
+  if(d < 0x80000000u)
+    return (int32_t)d;
+  return -(int32_t)(~d) - 1;
+}
+
+uint64_t unwrap_sample_index(uint32_t sample_index, uint64_t reference)
+{
+  return reference +
+         (int64_t)sample_index_diff(sample_index, (uint32_t)reference);
+}
+
+size_t get_buffer_length(const netaudio_info_t& info)
+{
+  return info.channels * info.fragsize * get_sample_size(info.samplefmt) +
+         netaudio_audio_data;
 }
 
 /*
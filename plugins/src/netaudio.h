@@ -13,6 +13,15 @@
  * @defgroup netaudioproto network audio protocol
  */
 
+/**
+ * Current protocol version.
+ *
+ * Version 1 is the host byte order copy of netaudio_info_t. Version 2
+ * has the same layout, but all fields, sample indices and samples are
+ * explicitly little-endian, see netaudio_wire.h.
+ */
+#define NETAUDIO_PROTOCOL_VERSION 2
+
 /**
  * List of sample formats.
  *
@@ -21,6 +30,21 @@
  */
 enum samplefmt_t : uint16_t { pcm16bit = 0, pcmfloat = 1 };
 
+/**
+ * @name Limits of stream configurations
+ *
+ * Decoders reject headers and audio chunks which exceed these limits,
+ * so the memory used by a receiver is bounded independent of the
+ * received data. The packet size limit includes the header of audio
+ * chunks.
+ */
+///@{
+#define NETAUDIO_MAX_CHANNELS 256
+#define NETAUDIO_MAX_FRAGSIZE 8192
+#define NETAUDIO_MAX_SRATE 1000000
+#define NETAUDIO_MAX_PACKET_SIZE 65536
+///@}
+
 /**
  * List of error codes.
  */
@@ -33,7 +57,10 @@ enum netaudio_err_t {
   netaudio_no_audiochunk,
   netaudio_unsupported_protocol_version,
   netaudio_invalid_buffer_dimensions,
-  netaudio_invalid_checksum
+  netaudio_invalid_checksum,
+  netaudio_not_a_report,
+  netaudio_unsupported_sample_format,
+  netaudio_limits_exceeded
 };
 
 /**
@@ -52,6 +79,39 @@ struct netaudio_info_t {
 static_assert(sizeof(netaudio_info_t) == 16,
               "size of netaudio_info_t is not 16 bytes");
 
+/**
+ * @brief Receiver report
+ *
+ * Receivers send reports back to the sender of a stream, to inform it
+ * about the reception quality.
+ */
+struct netaudio_report_t {
+  uint32_t chksum;       ///< checksum of the received stream configuration
+  uint32_t sample_index; ///< sample index following the latest chunk
+  float loss;   ///< fraction of frames lost or late since the last report
+  float jitter; ///< interarrival jitter in seconds, as in RFC 3550
+  float buffer; ///< jitter buffer fill in seconds
+  float drift;  ///< relative deviation of sender clock from receiver clock
+};
+
+/**
+ * @brief Audio codec of one stream configuration
+ *
+ * The sample conversion functions are specialized for the sample
+ * format and, for 1, 2, 8, 16, 32 and 64 channels, for the channel
+ * count of the stream. Use new_netaudio_codec() to select them once
+ * per stream configuration, rather than for every audio chunk.
+ */
+struct netaudio_codec_t {
+  netaudio_info_t info; ///< stream configuration
+  /// convert interleaved samples into wire format, or NULL
+  void (*encode)(const float* audio, size_t frames, size_t channels,
+                 char* data);
+  /// convert samples from wire format into interleaved samples, or NULL
+  void (*decode)(const char* data, size_t frames, size_t channels,
+                 float* audio);
+};
+
 /**
  * Compile an info header from sampling rate, sample format, channels
  *  and fragment size
@@ -60,15 +120,26 @@ static_assert(sizeof(netaudio_info_t) == 16,
  * @param[in] samplefmt Sample format
  * @param[in] channels Number of channels
  * @param[in] fragsize Number of samples per audio chunk
+ * @param[in] id Protocol version
  * @return Audio information data
  *
  * This function fills all fields of netaudio_info_t. The
- * netaudio_info_t::id member is set to a static value which depends
- * on the protocol version. The netaudio_info_t::chksum member is set
- * to a checksum of all values. A CRC32 checksum algorithm is used.
+ * netaudio_info_t::id member is set to the protocol version. The
+ * netaudio_info_t::chksum member is set to a checksum of all
+ * values. A CRC32 checksum algorithm is used.
  */
 netaudio_info_t new_netaudio_info(double srate, samplefmt_t samplefmt,
-                                  uint16_t channels, uint32_t fragsize);
+                                  uint16_t channels, uint32_t fragsize,
+                                  uint16_t id = NETAUDIO_PROTOCOL_VERSION);
+
+/**
+ * Select the codec for a stream configuration
+ *
+ * @param[in] info Audio information data
+ * @return Codec, with NULL conversion functions if the sample format
+ * is not supported
+ */
+netaudio_codec_t new_netaudio_codec(const netaudio_info_t& info);
 
 /**
  * Encode a netaudio_info_t into a header package
@@ -102,8 +173,13 @@ size_t encode_header(const netaudio_info_t& info, char* data, size_t len,
  *   large enough to read an encoded header
  * - netaudio_not_a_header: the data is not containing a netaudio info structure
  * - netaudio_unsupported_protocol_version: the protocol id is not
- *   supported
+ *   supported. Protocol versions 1 and 2 are supported.
  * - netaudio_invalid_checksum: the checksum is invalid.
+ * - netaudio_unsupported_sample_format: the sample format is unknown
+ * - netaudio_limits_exceeded: the number of channels, fragment size
+ *   or sampling rate is zero, or the stream exceeds the limits
+ *   NETAUDIO_MAX_CHANNELS, NETAUDIO_MAX_FRAGSIZE, NETAUDIO_MAX_SRATE
+ *   or NETAUDIO_MAX_PACKET_SIZE
  */
 size_t decode_header(netaudio_info_t& info, const char* data, size_t len,
                      netaudio_err_t& err);
@@ -116,7 +192,9 @@ size_t decode_header(netaudio_info_t& info, const char* data, size_t len,
  * @param[in] audio Audio samples
  * @param[in] num_elem Total number of audio samples, must be fragsize *
  * channels
- * @param[in] sample_index Index of first sample of buffer
+ * @param[in] sample_index Index of first sample of buffer. This is the lower
+ * 32 bits of the sender's sample timeline, it wraps around, see
+ * unwrap_sample_index().
  * @param[out] data Start of memory area where the data is stored.
  * @param[in] len Size of character array
  * @param[out] err Set to error code in case of failure, or to netaudio_success.
@@ -127,11 +205,39 @@ size_t decode_header(netaudio_info_t& info, const char* data, size_t len,
  * large enough to store the audio chunk.
  * - netaudio_invalid_pointer: the data or audio pointer is not valid
  * - netaudio_invalid_buffer_dimensions: num_elem is not fragsize * channels
+ * - netaudio_unsupported_sample_format: the sample format is unknown
  */
 size_t encode_audio(const netaudio_info_t& info, const float* audio,
                     size_t num_elem, uint32_t sample_index, char* data,
                     size_t len, netaudio_err_t& err);
 
+/**
+ * Encode an audio chunk with a codec selected by new_netaudio_codec().
+ *
+ * Parameters, return value and error codes are the same as in
+ * encode_audio().
+ */
+size_t encode_audio(const netaudio_codec_t& codec, const float* audio,
+                    size_t num_elem, uint32_t sample_index, char* data,
+                    size_t len, netaudio_err_t& err);
+
+/**
+ * Encode an audio chunk, omitting silent channels.
+ *
+ * Parameters, return value and error codes are the same as in
+ * encode_audio().
+ *
+ * Channels in which all samples are encoded as zero are marked in a
+ * channel mask and are not transmitted. If this does not reduce the
+ * size of the audio chunk, a regular audio chunk is encoded. The
+ * result is thus never larger than get_buffer_length(), and len must
+ * be at least get_buffer_length(). Decoding is done with
+ * decode_audio().
+ */
+size_t encode_audio_sparse(const netaudio_info_t& info, const float* audio,
+                           size_t num_elem, uint32_t sample_index, char* data,
+                           size_t len, netaudio_err_t& err);
+
 /**
  * Decode an audio package into audio samples.
  *
@@ -153,11 +259,110 @@ size_t encode_audio(const netaudio_info_t& info, const float* audio,
  * chunk
  * - netaudio_invalid_checksum: the checksum is invalid
  * - netaudio_invalid_buffer_dimensions: num_elem is not fragsize * channels
+ * - netaudio_unsupported_sample_format: the sample format is unknown
+ * - netaudio_limits_exceeded: the stream configuration or the packet
+ *   size exceeds the limits, see decode_header()
+ *
+ * Regular and sparse audio chunks (see encode_audio_sparse()) are
+ * decoded. Channels omitted from a sparse chunk are filled with
+ * zeros.
  */
 size_t decode_audio(const netaudio_info_t& info, float* audio, size_t num_elem,
                     uint32_t& sample_index, const char* data, size_t len,
                     netaudio_err_t& err);
 
+/**
+ * Decode an audio package with a codec selected by new_netaudio_codec().
+ *
+ * Parameters, return value and error codes are the same as in
+ * decode_audio(), except for the error code
+ * - netaudio_generic_error: the codec has no decoder
+ */
+size_t decode_audio(const netaudio_codec_t& codec, float* audio,
+                    size_t num_elem, uint32_t& sample_index, const char* data,
+                    size_t len, netaudio_err_t& err);
+
+/**
+ * Decode a range of channels of an audio package.
+ *
+ * @param[in] first First channel to decode
+ * @param[in] last Channel following the last channel to decode
+ *
+ * Only the channels in the range are written to audio, so several
+ * threads can decode disjoint ranges of the same package. Other
+ * parameters, return value and error codes are the same as in
+ * decode_audio(), except that netaudio_invalid_buffer_dimensions is
+ * also returned for an invalid channel range.
+ */
+size_t decode_audio_channels(const netaudio_codec_t& codec, float* audio,
+                             size_t num_elem, uint32_t& sample_index,
+                             const char* data, size_t len, size_t first,
+                             size_t last, netaudio_err_t& err);
+
+/**
+ * Encode a receiver report.
+ *
+ * @param[in] report Receiver report
+ * @param[out] data Start of memory area where the data is stored.
+ * @param[in] len Size of the data memory in bytes.
+ * @param[out] err Set to error code in case of failure, or to netaudio_success.
+ * @return Number of bytes written, or zero in case of failure.
+ *
+ * This function may fail with these error codes:
+ * - netaudio_invalid_pointer: the data pointer is not valid
+ * - netaudio_insufficient_memory: the size of the memory area is not
+ *   large enough to store the encoded report
+ */
+size_t encode_report(const netaudio_report_t& report, char* data, size_t len,
+                     netaudio_err_t& err);
+
+/**
+ * Decode a receiver report.
+ *
+ * @param[out] report Receiver report
+ * @param[in] data Start of memory area where the data is stored.
+ * @param[in] len Number of available bytes
+ * @param[out] err Set to error code in case of failure, or to netaudio_success.
+ * @return Number of bytes used, or zero in case of failure.
+ *
+ * This function may fail with these error codes:
+ * - netaudio_invalid_pointer: the data pointer is not valid
+ * - netaudio_insufficient_memory: the size of the memory area is not
+ *   large enough to read an encoded report
+ * - netaudio_not_a_report: the data is not containing a receiver report
+ *
+ * The stream is identified by netaudio_report_t::chksum, it is not
+ * checked by this function.
+ */
+size_t decode_report(netaudio_report_t& report, const char* data, size_t len,
+                     netaudio_err_t& err);
+
+/**
+ * Signed distance between two sample indices.
+ *
+ * Serial number arithmetic (RFC 1982) is used, i.e., the sample index
+ * may wrap around between a and b.
+ *
+ * @param[in] a Sample index
+ * @param[in] b Reference sample index
+ * @return Number of samples from b to a, in the range [-2^31,2^31)
+ */
+int32_t sample_index_diff(uint32_t a, uint32_t b);
+
+/**
+ * Extend a 32-bit sample index to a 64-bit sample timeline.
+ *
+ * @param[in] sample_index Sample index as transmitted in an audio chunk
+ * @param[in] reference Recent position on the 64-bit timeline
+ * @return Timeline position closest to reference whose lower 32 bits
+ * equal sample_index
+ *
+ * Receivers should keep the reference at least 2^31 samples away from
+ * zero (e.g., by starting at 2^32), so that the timeline never needs
+ * to go negative.
+ */
+uint64_t unwrap_sample_index(uint32_t sample_index, uint64_t reference);
+
 /**
  * Return the maximum buffer length required to store one audio chunk.
  *
@@ -175,11 +380,21 @@ size_t get_buffer_length(const netaudio_info_t& info);
  */
 size_t get_buffer_length_header();
 
+/**
+ * Return the buffer length required to store a receiver report.
+ *
+ * @return Number of Bytes needed
+ */
+size_t get_buffer_length_report();
+
 /**
  * Return the checksum of a netaudio info structure.
  *
  * @param[in] info Netaudio info structure
  * @return CRC32 checksum of all fields except checksum field
+ *
+ * The checksum is computed on the little-endian wire representation
+ * of the fields.
  */
 uint32_t get_checksum(netaudio_info_t info);
 
@@ -0,0 +1,144 @@
+#include <benchmark/benchmark.h>
+
+#include "netaudio.h"
+#include "netaudio_codec.h"
+#include <vector>
+
+// Sample conversion of one chunk, with the conversion loop specialized
+// on the number of channels (fixed_channels > 0) or generic:
+template <samplefmt_t fmt, size_t fixed_channels>
+static void BM_encode_samples(benchmark::State& state)
+{
+  size_t channels(state.range(0));
+  size_t frames(state.range(1));
+  std::vector<float> audio(channels * frames, 0.25f);
+  std::vector<char> data(channels * frames * netaudio_sample_t<fmt>::size);
+  for(auto _ : state) {
+    encode_samples<fmt, fixed_channels>(audio.data(), frames, channels,
+                                        data.data());
+    benchmark::DoNotOptimize(data.data());
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * channels * frames);
+}
+
+template <samplefmt_t fmt, size_t fixed_channels>
+static void BM_decode_samples(benchmark::State& state)
+{
+  size_t channels(state.range(0));
+  size_t frames(state.range(1));
+  std::vector<float> audio(channels * frames, 0.25f);
+  std::vector<char> data(channels * frames * netaudio_sample_t<fmt>::size);
+  encode_samples<fmt, 0>(audio.data(), frames, channels, data.data());
+  for(auto _ : state) {
+    decode_samples<fmt, fixed_channels>(data.data(), frames, channels,
+                                        audio.data());
+    benchmark::DoNotOptimize(audio.data());
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * channels * frames);
+}
+
+BENCHMARK_TEMPLATE(BM_encode_samples, pcm16bit, 0)
+    ->Args({2, 64})
+    ->Args({8, 64});
+BENCHMARK_TEMPLATE(BM_encode_samples, pcm16bit, 2)->Args({2, 64});
+BENCHMARK_TEMPLATE(BM_encode_samples, pcm16bit, 8)->Args({8, 64});
+BENCHMARK_TEMPLATE(BM_encode_samples, pcmfloat, 0)
+    ->Args({2, 64})
+    ->Args({8, 64});
+BENCHMARK_TEMPLATE(BM_encode_samples, pcmfloat, 2)->Args({2, 64});
+BENCHMARK_TEMPLATE(BM_encode_samples, pcmfloat, 8)->Args({8, 64});
+BENCHMARK_TEMPLATE(BM_decode_samples, pcm16bit, 0)
+    ->Args({2, 64})
+    ->Args({8, 64});
+BENCHMARK_TEMPLATE(BM_decode_samples, pcm16bit, 2)->Args({2, 64});
+BENCHMARK_TEMPLATE(BM_decode_samples, pcm16bit, 8)->Args({8, 64});
+BENCHMARK_TEMPLATE(BM_decode_samples, pcmfloat, 0)
+    ->Args({2, 64})
+    ->Args({8, 64});
+BENCHMARK_TEMPLATE(BM_decode_samples, pcmfloat, 2)->Args({2, 64});
+BENCHMARK_TEMPLATE(BM_decode_samples, pcmfloat, 8)->Args({8, 64});
+
+// Complete packets, including validation, as used by udpsend and
+// udpreceive:
+static void BM_encode_audio(benchmark::State& state)
+{
+  samplefmt_t fmt((samplefmt_t)state.range(0));
+  size_t channels(state.range(1));
+  size_t frames(state.range(2));
+  netaudio_info_t info(new_netaudio_info(48000, fmt, channels, frames));
+  netaudio_codec_t codec(new_netaudio_codec(info));
+  std::vector<float> audio(channels * frames, 0.25f);
+  std::vector<char> data(get_buffer_length(info));
+  netaudio_err_t err;
+  uint32_t sample_index(0);
+  for(auto _ : state) {
+    benchmark::DoNotOptimize(encode_audio(codec, audio.data(), audio.size(),
+                                          sample_index, data.data(),
+                                          data.size(), err));
+    sample_index += frames;
+  }
+  state.SetBytesProcessed(state.iterations() * data.size());
+}
+BENCHMARK(BM_encode_audio)
+    ->ArgsProduct({{pcm16bit, pcmfloat}, {2, 8, 128}, {64}});
+
+static void BM_decode_audio(benchmark::State& state)
+{
+  samplefmt_t fmt((samplefmt_t)state.range(0));
+  size_t channels(state.range(1));
+  size_t frames(state.range(2));
+  netaudio_info_t info(new_netaudio_info(48000, fmt, channels, frames));
+  netaudio_codec_t codec(new_netaudio_codec(info));
+  std::vector<float> audio(channels * frames, 0.25f);
+  std::vector<char> data(get_buffer_length(info));
+  netaudio_err_t err;
+  encode_audio(codec, audio.data(), audio.size(), 0, data.data(), data.size(),
+               err);
+  uint32_t sample_index(0);
+  for(auto _ : state)
+    benchmark::DoNotOptimize(decode_audio(codec, audio.data(), audio.size(),
+                                          sample_index, data.data(),
+                                          data.size(), err));
+  state.SetBytesProcessed(state.iterations() * data.size());
+}
+BENCHMARK(BM_decode_audio)
+    ->ArgsProduct({{pcm16bit, pcmfloat}, {2, 8, 128}, {64}});
+
+// Sparse packets with half of the channels silent:
+static void BM_encode_audio_sparse(benchmark::State& state)
+{
+  size_t channels(state.range(0));
+  size_t frames(state.range(1));
+  netaudio_info_t info(new_netaudio_info(48000, pcm16bit, channels, frames));
+  std::vector<float> audio(channels * frames, 0.0f);
+  for(size_t k = 0; k < frames; ++k)
+    for(size_t c = 0; c < channels; c += 2)
+      audio[k * channels + c] = 0.25f;
+  std::vector<char> data(get_buffer_length(info));
+  netaudio_err_t err;
+  for(auto _ : state)
+    benchmark::DoNotOptimize(encode_audio_sparse(info, audio.data(),
+                                                 audio.size(), 0, data.data(),
+                                                 data.size(), err));
+  state.SetItemsProcessed(state.iterations() * channels * frames);
+}
+BENCHMARK(BM_encode_audio_sparse)->Args({8, 64})->Args({32, 64});
+
+static void BM_gen_crc32b(benchmark::State& state)
+{
+  std::vector<uint8_t> data(state.range(0), 0x5a);
+  for(auto _ : state)
+    benchmark::DoNotOptimize(gen_crc32b(data.data(), data.size()));
+  state.SetBytesProcessed(state.iterations() * data.size());
+}
+// header size and a large packet:
+BENCHMARK(BM_gen_crc32b)->Arg(sizeof(netaudio_info_t))->Arg(1024);
+
+// Local Variables:
+// compile-command: "make -C .. benchmarks"
+// coding: utf-8-unix
+// c-basic-offset: 2
+// indent-tabs-mode: nil
+// End:
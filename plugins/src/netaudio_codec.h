@@ -0,0 +1,142 @@
+/**
+ * @file netaudio_codec.h
+ * @brief Sample conversion templates of the netaudio protocol
+ *
+ * The conversion loops are specialized at compile time on the sample
+ * format and optionally on the number of channels, so the compiler
+ * can unroll and vectorize them for common channel layouts. The
+ * specialization is selected once per stream by new_netaudio_codec().
+ */
+
+#ifndef NETAUDIO_CODEC_H
+#define NETAUDIO_CODEC_H
+
+#include "netaudio.h"
+#include "netaudio_wire.h"
+#include <algorithm>
+
+/**
+ * @brief Conversion of single samples between float and wire format
+ */
+template <samplefmt_t fmt> struct netaudio_sample_t;
+
+template <> struct netaudio_sample_t<pcm16bit> {
+  static constexpr size_t size = sizeof(int16_t);
+  /**
+   * Round to the nearest integer and saturate to the 16 bit range.
+   *
+   * Rounding is implemented with a conversion to int32_t, which is
+   * vectorized with SSE2, unlike lrintf().
+   */
+  static inline float quantize(float v)
+  {
+    v = std::max(-32768.0f, std::min(32767.0f, v));
+    return (float)(int32_t)(v + ((v < 0.0f) ? -0.5f : 0.5f));
+  };
+  /// Round to nearest, and saturate instead of wrapping around
+  static inline void encode(char* data, float v)
+  {
+    store_le16(data, (int16_t)quantize(v * ((1 << 15) - 1)));
+  };
+  static inline float decode(const char* data)
+  {
+    return (int16_t)load_le16(data) * (1.0f / ((1 << 15) - 1));
+  };
+};
+
+template <> struct netaudio_sample_t<pcmfloat> {
+  static constexpr size_t size = sizeof(float);
+  static inline void encode(char* data, float v) { store_lefloat(data, v); };
+  static inline float decode(const char* data) { return load_lefloat(data); };
+};
+
+/**
+ * Convert interleaved samples into wire format.
+ *
+ * @tparam fmt Sample format
+ * @tparam fixed_channels Number of channels, or zero for any number
+ * @param audio Interleaved audio samples
+ * @param frames Number of frames
+ * @param channels Number of channels, ignored if fixed_channels is
+ * not zero
+ * @param data Output buffer
+ */
+template <samplefmt_t fmt, size_t fixed_channels>
+void encode_samples(const float* audio, size_t frames, size_t channels,
+                    char* data)
+{
+  typedef netaudio_sample_t<fmt> sample_t;
+  if(fixed_channels)
+    channels = fixed_channels;
+  if constexpr((fmt == pcmfloat) && NETAUDIO_LITTLE_ENDIAN) {
+    memcpy(data, audio, sizeof(float) * frames * channels);
+  } else {
+    for(size_t k = 0; k < frames; ++k) {
+      const float* frame(&(audio[k * channels]));
+      char* dest(&(data[k * channels * sample_t::size]));
+      for(size_t c = 0; c < channels; ++c)
+        sample_t::encode(&(dest[c * sample_t::size]), frame[c]);
+    }
+  }
+}
+
+/**
+ * Convert samples from wire format into interleaved float samples.
+ *
+ * Parameters are the same as in encode_samples().
+ */
+template <samplefmt_t fmt, size_t fixed_channels>
+void decode_samples(const char* data, size_t frames, size_t channels,
+                    float* audio)
+{
+  typedef netaudio_sample_t<fmt> sample_t;
+  if(fixed_channels)
+    channels = fixed_channels;
+  if constexpr((fmt == pcmfloat) && NETAUDIO_LITTLE_ENDIAN) {
+    memcpy(audio, data, sizeof(float) * frames * channels);
+  } else {
+    for(size_t k = 0; k < frames; ++k) {
+      float* frame(&(audio[k * channels]));
+      const char* src(&(data[k * channels * sample_t::size]));
+      for(size_t c = 0; c < channels; ++c)
+        frame[c] = sample_t::decode(&(src[c * sample_t::size]));
+    }
+  }
+}
+
+/**
+ * Convert a range of channels from wire format into interleaved
+ * float samples, e.g., to decode channel groups in parallel.
+ *
+ * @tparam fmt Sample format
+ * @param data Samples in wire format
+ * @param frames Number of frames
+ * @param channels Number of channels
+ * @param first First channel to convert
+ * @param last Channel following the last channel to convert
+ * @param audio Interleaved audio samples, only the channels in the
+ * range are written
+ */
+template <samplefmt_t fmt>
+void decode_channels(const char* data, size_t frames, size_t channels,
+                     size_t first, size_t last, float* audio)
+{
+  typedef netaudio_sample_t<fmt> sample_t;
+  for(size_t k = 0; k < frames; ++k) {
+    float* frame(&(audio[k * channels]));
+    const char* src(&(data[k * channels * sample_t::size]));
+    for(size_t c = first; c < last; ++c)
+      frame[c] = sample_t::decode(&(src[c * sample_t::size]));
+  }
+}
+
+#endif
+
+/*
+ * Local Variables:
+ * mode: c++
+ * c-basic-offset: 2
+ * indent-tabs-mode: nil
+ * compile-command: "make -C .."
+ * End:
+ */
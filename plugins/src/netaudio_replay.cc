@@ -0,0 +1,238 @@
+/*
+  Offline analysis of netaudio capture files.
+
+  Packets of a capture file, recorded by the udpreceive plugin, are
+  passed through the receiver processing (decoding, jitter buffer and
+  clock estimation) with their original arrival times, but as fast as
+  possible. The jitter buffer is read at the nominal rate of the
+  stream, either with a fixed or with an adaptive playout delay.
+  Multiple jitter buffer settings can be evaluated in one call.
+ */
+
+#include "capture.h"
+#include "jittercontroller.h"
+#include "netaudio.h"
+#include "receiver.h"
+#include "resampler.h"
+#include "ringbuffer.h"
+#include <getopt.h>
+#include <iostream>
+#include <stdexcept>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+static void usage(struct option* opt)
+{
+  std::cout << "Usage:\n\nnetaudio_replay [options] capturefile\n\n"
+               "Options:\n\n";
+  while(opt->name) {
+    std::cout << "  -" << (char)(opt->val) << " " << (opt->has_arg ? "#" : "")
+              << "\n  --" << opt->name << (opt->has_arg ? "=#" : "") << "\n\n";
+    opt++;
+  }
+  std::cout << "  -b and -l may be given multiple times to compare settings.\n"
+               "  -l enables the adaptive playout delay, with the initial\n"
+               "  delay given by -b.\n";
+}
+
+struct replay_result_t {
+  size_t packets = 0;
+  size_t chunks = 0;
+  size_t reordered = 0;
+  size_t errors = 0;
+  size_t late_frames = 0;
+  size_t missing_frames = 0;
+  size_t played_frames = 0;
+  double srate_estimate = 0;
+  double mean_target = 0;
+  double mean_delay = 0;
+};
+
+struct replay_cfg_t {
+  double buffer = 10.0;
+  // tolerated late rate, or negative for fixed playout delay:
+  double maxloss = -1.0;
+  double minbuffer = 2.0;
+  double maxbuffer = 100.0;
+  uint32_t fragsize = 0;
+  double srate = 0;
+  bool verbose = false;
+};
+
+static bool scan_info(capture_reader_t& capture, netaudio_info_t& info)
+{
+  const char* data(NULL);
+  size_t len(0);
+  uint64_t timestamp(0);
+  capture.rewind();
+  while(capture.next(data, len, timestamp)) {
+    netaudio_err_t err;
+    decode_header(info, data, len, err);
+    if(err == netaudio_success)
+      return true;
+  }
+  return false;
+}
+
+static replay_result_t replay(capture_reader_t& capture,
+                              const netaudio_info_t& info,
+                              const replay_cfg_t& cfg)
+{
+  size_t delay(std::max(0.0, 0.001 * cfg.buffer * cfg.srate));
+  size_t maxdelay(
+      std::max(0.0, 0.001 * std::max(cfg.buffer, cfg.maxbuffer) * cfg.srate));
+  ringbuffer_ooowrite_t jitterbuffer(4u * (maxdelay + cfg.fragsize),
+                                     info.channels, delay);
+  netaudio_receiver_t receiver(jitterbuffer);
+  jitter_controller_t controller(cfg.srate, 0.001 * cfg.buffer,
+                                 0.001 * cfg.minbuffer, 0.001 * cfg.maxbuffer,
+                                 cfg.maxloss);
+  resampler_t resampler(info.channels, cfg.fragsize);
+  bool adaptive(cfg.maxloss >= 0);
+  if(adaptive)
+    receiver.set_controller(&controller);
+  std::vector<float> audio(cfg.fragsize * info.channels);
+  replay_result_t res;
+  const char* data(NULL);
+  size_t len(0);
+  uint64_t timestamp(0);
+  // time of next playout cycle, in ns since start of capture:
+  double t_play(-1);
+  double period(1e9 * cfg.fragsize / cfg.srate);
+  size_t cycles(0);
+  capture.rewind();
+  while(capture.next(data, len, timestamp)) {
+    if(t_play < 0)
+      t_play = timestamp;
+    while(t_play <= timestamp) {
+      if(adaptive) {
+        res.played_frames += resampler.read(
+            jitterbuffer, audio.data(), cfg.fragsize, controller.get_ratio());
+        res.mean_target += controller.get_target();
+        res.mean_delay += controller.get_delay();
+      } else {
+        res.played_frames += jitterbuffer.read_data(
+            audio.data(), cfg.fragsize, info.channels);
+        res.mean_target += 0.001 * cfg.buffer;
+        res.mean_delay += 0.001 * cfg.buffer;
+      }
+      ++cycles;
+      t_play += period;
+    }
+    netaudio_err_t err(receiver.process_packet(data, len, timestamp));
+    if(cfg.verbose)
+      printf("%.6f %zu %d %llu %zu %zu %g %g\n", 1e-9 * timestamp, len, err,
+             (unsigned long long)receiver.get_timeline(),
+             jitterbuffer.get_late_frames(), jitterbuffer.get_missing_frames(),
+             1000.0 * controller.get_target(), 1000.0 * controller.get_delay());
+  }
+  res.packets = receiver.get_packets();
+  res.chunks = receiver.get_chunks();
+  res.reordered = receiver.get_reordered();
+  res.errors = receiver.get_errors();
+  res.late_frames = jitterbuffer.get_late_frames();
+  res.missing_frames = jitterbuffer.get_missing_frames();
+  res.srate_estimate = receiver.get_srate_estimate();
+  if(cycles) {
+    res.mean_target /= cycles;
+    res.mean_delay /= cycles;
+  }
+  return res;
+}
+
+int main(int argc, char** argv)
+{
+  std::vector<double> buffers;
+  std::vector<double> maxlosses;
+  replay_cfg_t cfg;
+  const char* options = "b:l:m:M:f:r:vh";
+  struct option long_options[] = {{"buffer", 1, 0, 'b'},
+                                  {"maxloss", 1, 0, 'l'},
+                                  {"minbuffer", 1, 0, 'm'},
+                                  {"maxbuffer", 1, 0, 'M'},
+                                  {"fragsize", 1, 0, 'f'},
+                                  {"srate", 1, 0, 'r'},
+                                  {"verbose", 0, 0, 'v'},
+                                  {"help", 0, 0, 'h'},
+                                  {0, 0, 0, 0}};
+  int opt(0);
+  int option_index(0);
+  while((opt = getopt_long(argc, argv, options, long_options,
+                           &option_index)) != -1) {
+    switch(opt) {
+    case 'b':
+      buffers.push_back(atof(optarg));
+      break;
+    case 'l':
+      maxlosses.push_back(atof(optarg));
+      break;
+    case 'm':
+      cfg.minbuffer = atof(optarg);
+      break;
+    case 'M':
+      cfg.maxbuffer = atof(optarg);
+      break;
+    case 'f':
+      cfg.fragsize = atoi(optarg);
+      break;
+    case 'r':
+      cfg.srate = atof(optarg);
+      break;
+    case 'v':
+      cfg.verbose = true;
+      break;
+    case 'h':
+      usage(long_options);
+      return 0;
+    }
+  }
+  if(optind + 1 != argc) {
+    usage(long_options);
+    return 1;
+  }
+  if(buffers.empty())
+    buffers.push_back(10.0);
+  if(maxlosses.empty())
+    maxlosses.push_back(-1.0);
+  try {
+    capture_reader_t capture(argv[optind]);
+    netaudio_info_t info;
+    if(!scan_info(capture, info))
+      throw std::runtime_error("No valid header in capture file.");
+    // playout parameters default to those of the sender:
+    if(cfg.fragsize == 0)
+      cfg.fragsize = info.fragsize;
+    if(cfg.srate <= 0)
+      cfg.srate = info.srate;
+    printf("# channels: %d fragsize: %d srate: %g\n", info.channels,
+           info.fragsize, info.srate);
+    printf("# buffer/ms maxloss packets chunks reordered errors late missing "
+           "played srate_estimate mean_target/ms mean_delay/ms\n");
+    for(auto buffer : buffers)
+      for(auto maxloss : maxlosses) {
+        cfg.buffer = buffer;
+        cfg.maxloss = maxloss;
+        replay_result_t res(replay(capture, info, cfg));
+        printf("%g %g %zu %zu %zu %zu %zu %zu %zu %.3f %.3f %.3f\n", buffer,
+               maxloss, res.packets, res.chunks, res.reordered, res.errors,
+               res.late_frames, res.missing_frames, res.played_frames,
+               res.srate_estimate, 1000.0 * res.mean_target,
+               1000.0 * res.mean_delay);
+      }
+  }
+  catch(const std::exception& e) {
+    std::cerr << "Error: " << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
+
+/*
+ * Local Variables:
+ * mode: c++
+ * c-basic-offset: 2
+ * indent-tabs-mode: nil
+ * compile-command: "make -C .."
+ * End:
+ */
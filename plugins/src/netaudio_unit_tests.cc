@@ -1,20 +1,91 @@
 #include <gtest/gtest.h>
 
 #include "netaudio.h"
+#include "netaudio_codec.h"
+#include <math.h>
+#include <vector>
 
 #define BUFSIZE 4096
 
 TEST(netaudio, new_netaudio_info)
 {
-  netaudio_info_t inf(new_netaudio_info(44100, pcm16bit, 2, 64));
+  netaudio_info_t inf(new_netaudio_info(44100, pcm16bit, 2, 64, 1));
   EXPECT_EQ(44100, inf.srate);
   EXPECT_EQ(pcm16bit, inf.samplefmt);
   EXPECT_EQ(2u, inf.channels);
   EXPECT_EQ(64u, inf.fragsize);
   EXPECT_EQ(1u, inf.id);
   EXPECT_EQ(2259497000u, inf.chksum);
-  netaudio_info_t inf2(new_netaudio_info(44101, pcm16bit, 2, 64));
+  netaudio_info_t inf2(new_netaudio_info(44101, pcm16bit, 2, 64, 1));
   EXPECT_EQ(1193537512u, inf2.chksum);
+  netaudio_info_t inf3(new_netaudio_info(44100, pcm16bit, 2, 64));
+  EXPECT_EQ(2u, inf3.id);
+  EXPECT_EQ(NETAUDIO_PROTOCOL_VERSION, inf3.id);
+  EXPECT_NE(inf.chksum, inf3.chksum);
+}
+
+TEST(netaudio, header_wire_format)
+{
+  netaudio_info_t inf(new_netaudio_info(48000, pcmfloat, 0x0102, 0x0304));
+  char data[128];
+  netaudio_err_t err;
+  size_t size(encode_header(inf, data, 128, err));
+  ASSERT_EQ(17u, size);
+  // all fields are little-endian, independent of host byte order:
+  const uint8_t expected[13] = {1,    2,    0,    1,    0,    0x00, 0x80,
+                                0x3b, 0x47, 0x02, 0x01, 0x04, 0x03};
+  for(size_t k = 0; k < 13; ++k)
+    EXPECT_EQ(expected[k], (uint8_t)data[k]) << k;
+  uint32_t chksum(0);
+  for(size_t k = 0; k < 4; ++k)
+    chksum |= (uint32_t)((uint8_t)data[13 + k]) << (8 * k);
+  EXPECT_EQ(inf.chksum, chksum);
+  // the checksum is the CRC32 of the little-endian fields:
+  for(size_t k = 13; k < 17; ++k)
+    data[k] = 0;
+  EXPECT_EQ(inf.chksum, gen_crc32b((uint8_t*)(&(data[1])), 16));
+}
+
+TEST(netaudio, decode_header_versions)
+{
+  netaudio_err_t err;
+  char data[128];
+  netaudio_info_t inf2;
+  for(uint16_t id = 1; id < 4; ++id) {
+    netaudio_info_t inf(new_netaudio_info(44100, pcm16bit, 2, 64, id));
+    encode_header(inf, data, 128, err);
+    err = netaudio_success;
+    size_t size(decode_header(inf2, data, 128, err));
+    if(id < 3) {
+      EXPECT_EQ(netaudio_success, err);
+      EXPECT_EQ(17u, size);
+      EXPECT_EQ(id, inf2.id);
+      EXPECT_EQ(inf.chksum, inf2.chksum);
+    } else {
+      EXPECT_EQ(netaudio_unsupported_protocol_version, err);
+      EXPECT_EQ(0u, size);
+    }
+  }
+}
+
+TEST(netaudio, audio_wire_format)
+{
+  netaudio_info_t info(new_netaudio_info(44100, pcm16bit, 1, 2));
+  float audio[2] = {0.0f, -1.0f};
+  char data[128];
+  netaudio_err_t err;
+  size_t size(encode_audio(info, audio, 2, 0x01020304u, data, 128, err));
+  ASSERT_EQ(13u, size);
+  EXPECT_EQ(2, data[0]);
+  EXPECT_EQ(4, data[5]);
+  EXPECT_EQ(3, data[6]);
+  EXPECT_EQ(2, data[7]);
+  EXPECT_EQ(1, data[8]);
+  EXPECT_EQ(0, data[9]);
+  EXPECT_EQ(0, data[10]);
+  // -32767 = 0x8001:
+  EXPECT_EQ(0x01, (uint8_t)data[11]);
+  EXPECT_EQ(0x80, (uint8_t)data[12]);
 }
 
 TEST(netaudio, encode_header_errors)
@@ -42,7 +113,7 @@ TEST(netaudio, decode_header_errors)
   memset(&inf2, 0xff, sizeof(netaudio_info_t));
   netaudio_err_t err(netaudio_success);
   size_t size(1);
-  /* not yet tested:
+  /* tested in encode_decode_header and decode_header_versions:
    * - netaudio_unsupported_protocol_version: the protocol id is not
    *   supported
    * - netaudio_invalid_checksum: the checksum is invalid.
@@ -61,6 +132,52 @@ TEST(netaudio, decode_header_errors)
   EXPECT_EQ(netaudio_not_a_header, err);
 }
 
+TEST(netaudio, decode_header_limits)
+{
+  char data[128];
+  netaudio_err_t err;
+  netaudio_info_t decoded;
+  struct {
+    netaudio_info_t info;
+    netaudio_err_t err;
+  } cases[] = {
+      {new_netaudio_info(48000, pcmfloat, 256, 63), netaudio_success},
+      {new_netaudio_info(48000, (samplefmt_t)2, 2, 64),
+       netaudio_unsupported_sample_format},
+      {new_netaudio_info(48000, pcm16bit, 0, 64), netaudio_limits_exceeded},
+      {new_netaudio_info(48000, pcm16bit, 257, 1), netaudio_limits_exceeded},
+      {new_netaudio_info(48000, pcm16bit, 2, 0), netaudio_limits_exceeded},
+      {new_netaudio_info(48000, pcm16bit, 1, 8193), netaudio_limits_exceeded},
+      {new_netaudio_info(0, pcm16bit, 2, 64), netaudio_limits_exceeded},
+      {new_netaudio_info(2e6, pcm16bit, 2, 64), netaudio_limits_exceeded},
+      {new_netaudio_info(NAN, pcm16bit, 2, 64), netaudio_limits_exceeded},
+      // packet size exceeds NETAUDIO_MAX_PACKET_SIZE:
+      {new_netaudio_info(48000, pcmfloat, 256, 64), netaudio_limits_exceeded},
+  };
+  for(auto& c : cases) {
+    size_t len(encode_header(c.info, data, sizeof(data), err));
+    ASSERT_NE(0u, len);
+    EXPECT_EQ(c.err == netaudio_success ? len : 0u,
+              decode_header(decoded, data, len, err));
+    EXPECT_EQ(c.err, err);
+  }
+  // audio chunks are checked as well, since the stream configuration
+  // may be constructed from other sources:
+  netaudio_info_t info(new_netaudio_info(48000, pcm16bit, 1, 8193));
+  std::vector<float> audio(8193);
+  std::vector<char> packet(get_buffer_length(info));
+  uint32_t sample_index;
+  EXPECT_EQ(0u, decode_audio(info, audio.data(), audio.size(), sample_index,
+                             packet.data(), packet.size(), err));
+  EXPECT_EQ(netaudio_limits_exceeded, err);
+  info = new_netaudio_info(48000, pcm16bit, 1, 64);
+  packet.resize(NETAUDIO_MAX_PACKET_SIZE + 1u);
+  encode_audio(info, audio.data(), 64, 0, packet.data(), packet.size(), err);
+  EXPECT_EQ(0u, decode_audio(info, audio.data(), 64, sample_index,
+                             packet.data(), packet.size(), err));
+  EXPECT_EQ(netaudio_limits_exceeded, err);
+}
+
 TEST(netaudio, encode_decode_header)
 {
   netaudio_info_t inf(new_netaudio_info(44100, pcm16bit, 2, 64));
@@ -132,6 +249,7 @@ TEST(netaudio, decode_audio_errors)
     f16[k] = 0.01 * k;
   char char1k[1024];
   char char18[18];
+  memset(char18, 0, sizeof(char18));
   netaudio_err_t err;
   uint32_t sample_index(1);
   err = netaudio_success;
@@ -269,6 +387,296 @@ TEST(netaudio, sampleindex)
   }
 }
 
+TEST(netaudio, sample_index_diff)
+{
+  EXPECT_EQ(0, sample_index_diff(7u, 7u));
+  EXPECT_EQ(64, sample_index_diff(64u, 0u));
+  EXPECT_EQ(-64, sample_index_diff(0u, 64u));
+  EXPECT_EQ(64, sample_index_diff(32u, 0xffffffe0u));
+  EXPECT_EQ(-64, sample_index_diff(0xffffffe0u, 32u));
+  EXPECT_EQ(INT32_MAX, sample_index_diff(0x7fffffffu, 0u));
+  EXPECT_EQ(INT32_MIN, sample_index_diff(0x80000000u, 0u));
+}
+
+TEST(netaudio, unwrap_sample_index)
+{
+  uint64_t ref((uint64_t)1u << 32);
+  EXPECT_EQ(ref + 10u, unwrap_sample_index(10u, ref));
+  EXPECT_EQ(ref - 10u, unwrap_sample_index(0xfffffff6u, ref));
+  ref = ((uint64_t)2u << 32) - 32u;
+  EXPECT_EQ(((uint64_t)2u << 32) + 32u, unwrap_sample_index(32u, ref));
+  // a reordered chunk from before the wrap point:
+  EXPECT_EQ(ref - 64u, unwrap_sample_index(0xffffffa0u, ref + 96u));
+}
+
+TEST(netaudio, sampleindex_wraparound)
+{
+  netaudio_info_t info(new_netaudio_info(44100, pcmfloat, 1, 8));
+  float audio[8];
+  char buffer[BUFSIZE];
+  // encode eight chunks across the wrap point, deliver in swapped pairs:
+  uint32_t first_index(0xffffffe0u);
+  uint64_t timeline((uint64_t)1u << 32);
+  timeline += first_index;
+  const size_t order[8] = {1, 0, 3, 2, 5, 4, 7, 6};
+  for(size_t n = 0; n < 8; ++n) {
+    for(size_t k = 0; k < 8; ++k)
+      audio[k] = 8 * order[n] + k;
+    netaudio_err_t err(netaudio_invalid_checksum);
+    size_t encsize(encode_audio(info, audio, 8, first_index + 8u * order[n],
+                                buffer, BUFSIZE, err));
+    ASSERT_EQ(netaudio_success, err);
+    uint32_t sample_index(0);
+    decode_audio(info, audio, 8, sample_index, buffer, encsize, err);
+    ASSERT_EQ(netaudio_success, err);
+    timeline = unwrap_sample_index(sample_index, timeline);
+    EXPECT_EQ(((uint64_t)1u << 32) + first_index + 8u * order[n], timeline);
+    EXPECT_EQ(8.0f * order[n], audio[0]);
+  }
+}
+
+TEST(netaudio, encode_decode_audio_sparse)
+{
+  for(samplefmt_t fmt : {pcm16bit, pcmfloat}) {
+    netaudio_info_t info(new_netaudio_info(44100, fmt, 12, 8));
+    float audio[96];
+    float audio2[96];
+    // channels 1, 4, 5, 11 are active, channel 7 is below 16 bit resolution:
+    for(size_t k = 0; k < 8; ++k)
+      for(size_t c = 0; c < 12; ++c) {
+        float v(0.0f);
+        if((c == 1) || (c == 4) || (c == 5) || (c == 11))
+          v = 0.01f * (k + 1) * ((c & 1) ? -1.0f : 1.0f);
+        if(c == 7)
+          v = 1e-6f;
+        audio[c + 12 * k] = v;
+      }
+    char data[1024];
+    netaudio_err_t err(netaudio_invalid_pointer);
+    size_t len(encode_audio_sparse(info, audio, 96, 77, data, 1024, err));
+    EXPECT_EQ(netaudio_success, err);
+    ASSERT_LT(len, get_buffer_length(info));
+    EXPECT_EQ(3, data[0]);
+    // mask:
+    if(fmt == pcm16bit) {
+      EXPECT_EQ(0x32, data[9]);
+      EXPECT_EQ(9u + 2u + 4u * 8u * 2u, len);
+    } else {
+      EXPECT_EQ((char)0xb2, data[9]);
+      EXPECT_EQ(9u + 2u + 5u * 8u * 4u, len);
+    }
+    EXPECT_EQ(0x08, data[10]);
+    // sparse chunks are decoded like full chunks:
+    float audio3[96];
+    char data3[1024];
+    size_t len3(encode_audio(info, audio, 96, 77, data3, 1024, err));
+    uint32_t sample_index(0);
+    EXPECT_EQ(len3, decode_audio(info, audio3, 96, sample_index, data3, len3,
+                                 err));
+    for(size_t k = 0; k < 96; ++k)
+      audio2[k] = 1.0f;
+    EXPECT_EQ(len,
+              decode_audio(info, audio2, 96, sample_index, data, len, err));
+    EXPECT_EQ(netaudio_success, err);
+    EXPECT_EQ(77u, sample_index);
+    for(size_t k = 0; k < 96; ++k)
+      EXPECT_EQ(audio3[k], audio2[k]) << k;
+    // truncated package:
+    EXPECT_EQ(0u,
+              decode_audio(info, audio2, 96, sample_index, data, len - 1, err));
+    EXPECT_EQ(netaudio_insufficient_memory, err);
+    data[1]++;
+    EXPECT_EQ(0u, decode_audio(info, audio2, 96, sample_index, data, len, err));
+    EXPECT_EQ(netaudio_invalid_checksum, err);
+  }
+}
+
+TEST(netaudio, decode_audio_channels)
+{
+  for(samplefmt_t fmt : {pcm16bit, pcmfloat}) {
+    netaudio_info_t info(new_netaudio_info(44100, fmt, 12, 8));
+    netaudio_codec_t codec(new_netaudio_codec(info));
+    float audio[96];
+    for(size_t k = 0; k < 96; ++k)
+      audio[k] = ((k % 12u) & 2u) ? 0.0f : 0.01f * k;
+    char data[1024];
+    char sparse[1024];
+    netaudio_err_t err;
+    size_t len(encode_audio(info, audio, 96, 5, data, 1024, err));
+    size_t sparselen(
+        encode_audio_sparse(info, audio, 96, 5, sparse, 1024, err));
+    ASSERT_LT(sparselen, len);
+    float full[96];
+    uint32_t sample_index(0);
+    EXPECT_EQ(len, decode_audio(codec, full, 96, sample_index, data, len, err));
+    // channel ranges are decoded like full chunks, other channels
+    // are not modified:
+    for(const char* packet : {data, sparse}) {
+      size_t plen((packet == data) ? len : sparselen);
+      float part[96];
+      for(size_t k = 0; k < 96; ++k)
+        part[k] = -1.0f;
+      sample_index = 0;
+      EXPECT_EQ(plen, decode_audio_channels(codec, part, 96, sample_index,
+                                            packet, plen, 3, 7, err));
+      EXPECT_EQ(netaudio_success, err);
+      EXPECT_EQ(5u, sample_index);
+      for(size_t k = 0; k < 96; ++k)
+        if((k % 12u >= 3u) && (k % 12u < 7u))
+          EXPECT_EQ(full[k], part[k]) << k;
+        else
+          EXPECT_EQ(-1.0f, part[k]) << k;
+    }
+    // invalid ranges:
+    EXPECT_EQ(0u, decode_audio_channels(codec, full, 96, sample_index, data,
+                                        len, 7, 3, err));
+    EXPECT_EQ(netaudio_invalid_buffer_dimensions, err);
+    EXPECT_EQ(0u, decode_audio_channels(codec, full, 96, sample_index, data,
+                                        len, 0, 13, err));
+    EXPECT_EQ(netaudio_invalid_buffer_dimensions, err);
+  }
+}
+
+TEST(netaudio, encode_audio_sparse_fallback)
+{
+  netaudio_info_t info(new_netaudio_info(44100, pcm16bit, 2, 8));
+  float audio[16];
+  for(size_t k = 0; k < 16; ++k)
+    audio[k] = 0.5f;
+  char data[1024];
+  char data2[1024];
+  netaudio_err_t err;
+  // all channels active: regular chunk is encoded
+  size_t len(encode_audio_sparse(info, audio, 16, 1, data, 1024, err));
+  EXPECT_EQ(netaudio_success, err);
+  EXPECT_EQ(get_buffer_length(info), len);
+  size_t len2(encode_audio(info, audio, 16, 1, data2, 1024, err));
+  ASSERT_EQ(len2, len);
+  EXPECT_EQ(0, memcmp(data, data2, len));
+  // silence: only mask is transmitted
+  for(size_t k = 0; k < 16; ++k)
+    audio[k] = 0.0f;
+  len = encode_audio_sparse(info, audio, 16, 1, data, 1024, err);
+  EXPECT_EQ(10u, len);
+  EXPECT_EQ(0, data[9]);
+  // insufficient memory is reported for less than get_buffer_length():
+  len = encode_audio_sparse(info, audio, 16, 1, data, 40, err);
+  EXPECT_EQ(0u, len);
+  EXPECT_EQ(netaudio_insufficient_memory, err);
+}
+
+TEST(netaudio, codec_specializations)
+{
+  for(samplefmt_t fmt : {pcm16bit, pcmfloat}) {
+    // specialized and generic channel counts:
+    for(uint16_t channels : {1, 2, 3, 8, 16, 32, 64, 65}) {
+      netaudio_info_t info(new_netaudio_info(48000, fmt, channels, 32));
+      netaudio_codec_t codec(new_netaudio_codec(info));
+      netaudio_codec_t generic(codec);
+      if(fmt == pcm16bit) {
+        generic.encode = &encode_samples<pcm16bit, 0>;
+        generic.decode = &decode_samples<pcm16bit, 0>;
+      } else {
+        generic.encode = &encode_samples<pcmfloat, 0>;
+        generic.decode = &decode_samples<pcmfloat, 0>;
+      }
+      if(channels % 8 == 0 || channels <= 2)
+        EXPECT_NE(generic.encode, codec.encode) << channels;
+      else
+        EXPECT_EQ(generic.encode, codec.encode) << channels;
+      size_t num_elem(32u * channels);
+      std::vector<float> audio(num_elem);
+      for(size_t k = 0; k < num_elem; ++k)
+        audio[k] = 0.9f * sinf(0.1f * k);
+      std::vector<char> data(get_buffer_length(info));
+      std::vector<char> data2(get_buffer_length(info));
+      netaudio_err_t err;
+      EXPECT_EQ(data.size(), encode_audio(codec, audio.data(), num_elem, 7,
+                                          data.data(), data.size(), err));
+      EXPECT_EQ(data.size(), encode_audio(generic, audio.data(), num_elem, 7,
+                                          data2.data(), data2.size(), err));
+      EXPECT_EQ(data, data2);
+      std::vector<float> audio2(num_elem);
+      std::vector<float> audio3(num_elem);
+      uint32_t sample_index(0);
+      EXPECT_EQ(data.size(), decode_audio(codec, audio2.data(), num_elem,
+                                          sample_index, data.data(),
+                                          data.size(), err));
+      EXPECT_EQ(7u, sample_index);
+      EXPECT_EQ(data.size(), decode_audio(generic, audio3.data(), num_elem,
+                                          sample_index, data.data(),
+                                          data.size(), err));
+      EXPECT_EQ(audio2, audio3);
+      for(size_t k = 0; k < num_elem; ++k)
+        ASSERT_NEAR(audio[k], audio2[k], 1.0f / 32767.0f);
+    }
+  }
+  // unsupported sample format:
+  netaudio_info_t info(new_netaudio_info(48000, (samplefmt_t)7, 2, 32));
+  netaudio_codec_t codec(new_netaudio_codec(info));
+  EXPECT_TRUE(codec.encode == NULL);
+  EXPECT_TRUE(codec.decode == NULL);
+  float audio[64];
+  char data[1024];
+  netaudio_err_t err;
+  EXPECT_EQ(0u, encode_audio(codec, audio, 64, 0, data, 1024, err));
+  EXPECT_EQ(netaudio_unsupported_sample_format, err);
+  EXPECT_EQ(0u, encode_audio_sparse(info, audio, 64, 0, data, 1024, err));
+  EXPECT_EQ(netaudio_unsupported_sample_format, err);
+}
+
+TEST(netaudio, pcm16bit_rounding_saturation)
+{
+  netaudio_info_t info(new_netaudio_info(48000, pcm16bit, 1, 8));
+  const float lsb(1.0f / 32767.0f);
+  float audio[8] = {0.4f * lsb, 0.6f * lsb,  -0.6f * lsb, 100.4f * lsb,
+                    1.0f,       1.5f,        -1.0f,       -1.5f};
+  char data[1024];
+  netaudio_err_t err;
+  size_t len(encode_audio(info, audio, 8, 0, data, 1024, err));
+  ASSERT_EQ(get_buffer_length(info), len);
+  int16_t expected[8] = {0, 1, -1, 100, 32767, 32767, -32767, -32768};
+  for(size_t k = 0; k < 8; ++k)
+    EXPECT_EQ(expected[k], (int16_t)((uint8_t)data[9 + 2 * k] |
+                                     ((uint8_t)data[10 + 2 * k] << 8)))
+        << k;
+}
+
+TEST(netaudio, report)
+{
+  netaudio_report_t report;
+  report.chksum = 0x12345678u;
+  report.sample_index = 0xfffffff0u;
+  report.loss = 0.125f;
+  report.jitter = 0.002f;
+  report.buffer = 0.01f;
+  report.drift = -1e-4f;
+  char data[64];
+  netaudio_err_t err;
+  EXPECT_EQ(0u, encode_report(report, data, get_buffer_length_report() - 1u,
+                              err));
+  EXPECT_EQ(netaudio_insufficient_memory, err);
+  size_t len(encode_report(report, data, sizeof(data), err));
+  EXPECT_EQ(netaudio_success, err);
+  EXPECT_EQ(get_buffer_length_report(), len);
+  netaudio_report_t decoded;
+  EXPECT_EQ(len, decode_report(decoded, data, len, err));
+  EXPECT_EQ(netaudio_success, err);
+  EXPECT_EQ(report.chksum, decoded.chksum);
+  EXPECT_EQ(report.sample_index, decoded.sample_index);
+  EXPECT_EQ(report.loss, decoded.loss);
+  EXPECT_EQ(report.jitter, decoded.jitter);
+  EXPECT_EQ(report.buffer, decoded.buffer);
+  EXPECT_EQ(report.drift, decoded.drift);
+  EXPECT_EQ(0u, decode_report(decoded, data, len - 1u, err));
+  EXPECT_EQ(netaudio_insufficient_memory, err);
+  // headers are not reports:
+  netaudio_info_t info(new_netaudio_info(48000, pcm16bit, 1, 8));
+  encode_header(info, data, sizeof(data), err);
+  EXPECT_EQ(0u, decode_report(decoded, data, sizeof(data), err));
+  EXPECT_EQ(netaudio_not_a_report, err);
+}
+
 // Local Variables:
 // compile-command: "make -C .. unit-tests"
 // coding: utf-8-unix
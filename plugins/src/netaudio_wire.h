@@ -0,0 +1,219 @@
+/**
+ * @file netaudio_wire.h
+ * @brief Wire encoding of the netaudio protocol
+ *
+ * All multi-byte fields are little-endian on the wire. On
+ * little-endian hosts the load and store functions reduce to plain
+ * memory access.
+ */
+
+#ifndef NETAUDIO_WIRE_H
+#define NETAUDIO_WIRE_H
+
+#include "netaudio.h"
+#include <stddef.h>
+#include <string.h>
+
+#define NETAUDIO_HEADER '\001'
+#define NETAUDIO_AUDIO '\002'
+#define NETAUDIO_AUDIO_SPARSE '\003'
+#define NETAUDIO_REPORT '\004'
+#define NETAUDIO_SEALED '\005'
+
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define NETAUDIO_LITTLE_ENDIAN 1
+#else
+#define NETAUDIO_LITTLE_ENDIAN 0
+#endif
+
+/**
+ * @ingroup netaudioproto
+ * @name Header package layout
+ *
+ * Byte offsets of the fields of a header package. Protocol version 1
+ * is a copy of netaudio_info_t in host byte order, version 2 is
+ * explicitly little-endian. Both are identical on little-endian
+ * hosts.
+ */
+///@{
+constexpr size_t netaudio_hdr_type = 0;
+constexpr size_t netaudio_hdr_id = 1;
+constexpr size_t netaudio_hdr_samplefmt = 3;
+constexpr size_t netaudio_hdr_srate = 5;
+constexpr size_t netaudio_hdr_channels = 9;
+constexpr size_t netaudio_hdr_fragsize = 11;
+constexpr size_t netaudio_hdr_chksum = 13;
+constexpr size_t netaudio_hdr_size = 17;
+///@}
+
+/**
+ * @ingroup netaudioproto
+ * @name Audio package layout
+ *
+ * Sparse audio packages (NETAUDIO_AUDIO_SPARSE) have a channel mask
+ * of (channels+7)/8 bytes at netaudio_audio_data, followed by the
+ * samples of the channels marked in the mask. Bit n of byte m marks
+ * channel 8m+n.
+ */
+///@{
+constexpr size_t netaudio_audio_type = 0;
+constexpr size_t netaudio_audio_chksum = 1;
+constexpr size_t netaudio_audio_sampleindex = 5;
+constexpr size_t netaudio_audio_data = 9;
+///@}
+
+/**
+ * @ingroup netaudioproto
+ * @name Receiver report package layout
+ *
+ * Receiver reports are sent from receivers to the sender, see
+ * netaudio_report_t.
+ */
+///@{
+constexpr size_t netaudio_report_type = 0;
+constexpr size_t netaudio_report_chksum = 1;
+constexpr size_t netaudio_report_sampleindex = 5;
+constexpr size_t netaudio_report_loss = 9;
+constexpr size_t netaudio_report_jitter = 13;
+constexpr size_t netaudio_report_buffer = 17;
+constexpr size_t netaudio_report_drift = 21;
+constexpr size_t netaudio_report_size = 25;
+///@}
+
+/**
+ * @ingroup netaudioproto
+ * @name Sealed package layout
+ *
+ * Sealed packages contain any other package, encrypted and
+ * authenticated with an AEAD cipher, see packet_cipher_t. The nonce
+ * is the sender salt followed by the sequence number. The clear
+ * text fields before netaudio_sealed_data are authenticated as
+ * additional data, the authentication tag follows the encrypted
+ * package.
+ */
+///@{
+constexpr size_t netaudio_sealed_type = 0;
+constexpr size_t netaudio_sealed_salt = 1;
+constexpr size_t netaudio_sealed_seq = 5;
+constexpr size_t netaudio_sealed_data = 13;
+constexpr size_t netaudio_sealed_tagsize = 16;
+///@}
+
+static_assert(netaudio_hdr_id == 1 + offsetof(netaudio_info_t, id),
+              "header id offset differs from protocol version 1");
+static_assert(netaudio_hdr_samplefmt ==
+                  1 + offsetof(netaudio_info_t, samplefmt),
+              "header samplefmt offset differs from protocol version 1");
+static_assert(netaudio_hdr_srate == 1 + offsetof(netaudio_info_t, srate),
+              "header srate offset differs from protocol version 1");
+static_assert(netaudio_hdr_channels == 1 + offsetof(netaudio_info_t, channels),
+              "header channels offset differs from protocol version 1");
+static_assert(netaudio_hdr_fragsize == 1 + offsetof(netaudio_info_t, fragsize),
+              "header fragsize offset differs from protocol version 1");
+static_assert(netaudio_hdr_chksum == 1 + offsetof(netaudio_info_t, chksum),
+              "header chksum offset differs from protocol version 1");
+static_assert(netaudio_hdr_size == 1 + sizeof(netaudio_info_t),
+              "header size differs from protocol version 1");
+static_assert(netaudio_audio_sampleindex ==
+                  netaudio_audio_chksum + sizeof(uint32_t),
+              "invalid audio package layout");
+static_assert(netaudio_audio_data ==
+                  netaudio_audio_sampleindex + sizeof(uint32_t),
+              "invalid audio package layout");
+static_assert(sizeof(float) == sizeof(uint32_t), "float is not 32 bit");
+
+inline void store_le16(char* p, uint16_t v)
+{
+#if NETAUDIO_LITTLE_ENDIAN
+  memcpy(p, &v, sizeof(v));
+#else
+  p[0] = (char)(v & 0xff);
+  p[1] = (char)(v >> 8);
+#endif
+}
+
+inline uint16_t load_le16(const char* p)
+{
+  uint16_t v;
+#if NETAUDIO_LITTLE_ENDIAN
+  memcpy(&v, p, sizeof(v));
+#else
+  const uint8_t* u((const uint8_t*)p);
+  v = (uint16_t)(u[0] | (u[1] << 8));
+#endif
+  return v;
+}
+
+inline void store_le32(char* p, uint32_t v)
+{
+#if NETAUDIO_LITTLE_ENDIAN
+  memcpy(p, &v, sizeof(v));
+#else
+  for(size_t k = 0; k < 4; ++k)
+    p[k] = (char)((v >> (8 * k)) & 0xff);
+#endif
+}
+
+inline uint32_t load_le32(const char* p)
+{
+  uint32_t v;
+#if NETAUDIO_LITTLE_ENDIAN
+  memcpy(&v, p, sizeof(v));
+#else
+  const uint8_t* u((const uint8_t*)p);
+  v = 0;
+  for(size_t k = 0; k < 4; ++k)
+    v |= (uint32_t)u[k] << (8 * k);
+#endif
+  return v;
+}
+
+inline void store_le64(char* p, uint64_t v)
+{
+#if NETAUDIO_LITTLE_ENDIAN
+  memcpy(p, &v, sizeof(v));
+#else
+  for(size_t k = 0; k < 8; ++k)
+    p[k] = (char)((v >> (8 * k)) & 0xff);
+#endif
+}
+
+inline uint64_t load_le64(const char* p)
+{
+  uint64_t v;
+#if NETAUDIO_LITTLE_ENDIAN
+  memcpy(&v, p, sizeof(v));
+#else
+  const uint8_t* u((const uint8_t*)p);
+  v = 0;
+  for(size_t k = 0; k < 8; ++k)
+    v |= (uint64_t)u[k] << (8 * k);
+#endif
+  return v;
+}
+
+inline void store_lefloat(char* p, float v)
+{
+  uint32_t u;
+  memcpy(&u, &v, sizeof(u));
+  store_le32(p, u);
+}
+
+inline float load_lefloat(const char* p)
+{
+  uint32_t u(load_le32(p));
+  float v;
+  memcpy(&v, &u, sizeof(v));
+  return v;
+}
+
+#endif
+
+/*
+ * Local Variables:
+ * mode: c++
+ * c-basic-offset: 2
+ * indent-tabs-mode: nil
+ * compile-command: "make -C .."
+ * End:
+ */
@@ -0,0 +1,166 @@
+#include "receiver.h"
+#include "jittercontroller.h"
+#include "workerpool.h"
+#include <algorithm>
+#include <atomic>
+#include <math.h>
+
+netaudio_receiver_t::netaudio_receiver_t(ringbuffer_ooowrite_t& jitterbuffer)
+    : jitterbuffer(jitterbuffer)
+{
+}
+
+netaudio_receiver_t::~netaudio_receiver_t()
+{
+  free(audio);
+  delete workers;
+}
+
+void netaudio_receiver_t::set_threads(size_t threads)
+{
+  delete workers;
+  workers = NULL;
+  if(threads > 1u) {
+    workers = new worker_pool_t(NETAUDIO_MAX_CHANNELS, threads);
+    if(info_valid)
+      workers->partition(info.channels);
+  }
+}
+
+netaudio_err_t netaudio_receiver_t::process_packet(const char* data,
+                                                   size_t len, uint64_t arrival)
+{
+  ++packets;
+  netaudio_err_t err;
+  netaudio_info_t newinfo;
+  decode_header(newinfo, data, len, err);
+  if(err == netaudio_success) {
+    ++headers;
+    // the chunk size may be the same for a different number of channels:
+    if(workers && (!info_valid || (newinfo.channels != info.channels)))
+      workers->partition(newinfo.channels);
+    info = newinfo;
+    codec = new_netaudio_codec(info);
+    if(info.srate != nominalsrate) {
+      nominalsrate = info.srate;
+      w_samplecnt = nominalsrate;
+      w_duration = 1.0;
+    }
+    if(audio_numelem != (size_t)info.channels * info.fragsize) {
+      audio_numelem = info.channels * info.fragsize;
+      free(audio);
+      // see worker_pool_t for the alignment of channel groups:
+      audio = aligned_audio_alloc(audio_numelem);
+    }
+    info_valid = true;
+    return err;
+  }
+  if(!info_valid) {
+    ++errors;
+    return err;
+  }
+  uint32_t sample_index(0);
+  if(workers) {
+    // all groups validate the chunk, the chunk fails if any group fails:
+    std::atomic<netaudio_err_t> group_failure(netaudio_success);
+    workers->run([&](size_t first, size_t last) {
+      netaudio_err_t group_err;
+      uint32_t group_index(0);
+      decode_audio_channels(codec, audio, audio_numelem, group_index, data,
+                            len, first, last, group_err);
+      if(first == 0u) {
+        err = group_err;
+        sample_index = group_index;
+      } else if(group_err != netaudio_success) {
+        group_failure.store(group_err);
+      }
+    });
+    if(err == netaudio_success)
+      err = group_failure.load();
+  } else {
+    decode_audio(codec, audio, audio_numelem, sample_index, data, len, err);
+  }
+  if(err != netaudio_success) {
+    ++errors;
+    return err;
+  }
+  ++chunks;
+  if(!has_timeline) {
+    timeline += sample_index;
+    prev_sampleidx = sample_index;
+    prev_arrival = arrival;
+    // the first report covers the time after the first chunk:
+    highest = timeline + info.fragsize;
+    highest_arrival = arrival;
+    report_highest = highest;
+    report_received = info.fragsize;
+    report_arrival = arrival;
+    has_timeline = true;
+  }
+  timeline = unwrap_sample_index(sample_index, timeline);
+  received += info.fragsize;
+  if((int64_t)(timeline + info.fragsize - highest) > 0) {
+    highest = timeline + info.fragsize;
+    highest_arrival = arrival;
+  }
+  // transit time relative to an arbitrary offset, in seconds:
+  double transit(1e-9 * (double)arrival - (double)timeline / nominalsrate);
+  if(chunks > 1u)
+    jitter += (fabs(transit - prev_transit) - jitter) / 16.0;
+  prev_transit = transit;
+  size_t late_frames(jitterbuffer.get_late_frames());
+  jitterbuffer.write_data(audio, info.fragsize, info.channels, timeline);
+  if(controller)
+    controller->update(timeline, info.fragsize, jitterbuffer.get_read_pos(),
+                       arrival, jitterbuffer.get_late_frames() != late_frames);
+  int32_t samples(sample_index_diff(sample_index, prev_sampleidx));
+  if(samples > 0) {
+    // reordered chunks are not counted:
+    prev_sampleidx = sample_index;
+    double dt(1e-9 * (double)(arrival - prev_arrival));
+    prev_arrival = arrival;
+    w_samplecnt *= c;
+    w_samplecnt += samples;
+    w_duration *= c;
+    w_duration += dt;
+  } else if(samples < 0) {
+    ++reordered;
+  }
+  return err;
+}
+
+bool netaudio_receiver_t::get_report(netaudio_report_t& report)
+{
+  if(!(info_valid && has_timeline))
+    return false;
+  size_t late(jitterbuffer.get_late_frames());
+  double expected((double)(int64_t)(highest - report_highest));
+  double lost(expected - (double)(received - report_received) +
+              (double)(late - report_late));
+  report.chksum = info.chksum;
+  report.sample_index = (uint32_t)highest;
+  report.loss = 0.0f;
+  if(expected > 0.0)
+    report.loss = std::max(0.0, std::min(1.0, lost / expected));
+  report.jitter = jitter;
+  report.buffer =
+      (double)(int64_t)(highest - jitterbuffer.get_read_pos()) / info.srate;
+  report.drift = 0.0f;
+  double duration(1e-9 * (double)(int64_t)(highest_arrival - report_arrival));
+  if((expected > 0.0) && (duration > 0.0))
+    report.drift = expected / (duration * info.srate) - 1.0;
+  report_highest = highest;
+  report_arrival = highest_arrival;
+  report_received = received;
+  report_late = late;
+  return true;
+}
+
+/*
+ * Local Variables:
+ * mode: c++
+ * c-basic-offset: 2
+ * indent-tabs-mode: nil
+ * compile-command: "make -C .."
+ * End:
+ */
@@ -0,0 +1,144 @@
+/**
+ * @file receiver.h
+ * @brief Receiver side processing of netaudio packets
+ */
+
+#ifndef RECEIVER_H
+#define RECEIVER_H
+
+#include "netaudio.h"
+#include "ringbuffer.h"
+
+class jitter_controller_t;
+class worker_pool_t;
+
+/**
+ * @brief Decode packets into a jitter buffer and estimate the sender clock
+ *
+ * This class is independent of the packet transport and of the
+ * system clock: packets are passed together with their arrival
+ * time. It is used by the udpreceive plugin as well as for offline
+ * analysis of capture files.
+ */
+class netaudio_receiver_t {
+public:
+  /**
+   * @param jitterbuffer Jitter buffer to write decoded audio into
+   */
+  netaudio_receiver_t(ringbuffer_ooowrite_t& jitterbuffer);
+  ~netaudio_receiver_t();
+  /**
+   * Process one packet.
+   *
+   * @param data Packet data
+   * @param len Packet size in bytes
+   * @param arrival Arrival time in nanoseconds, see get_time_ns()
+   * @return Error code of header or audio decoding
+   */
+  netaudio_err_t process_packet(const char* data, size_t len,
+                                uint64_t arrival);
+  /**
+   * Set a controller which is updated with every audio chunk.
+   *
+   * @param controller Playout delay controller, or NULL
+   */
+  void set_controller(jitter_controller_t* controller_)
+  {
+    controller = controller_;
+  };
+  /**
+   * Set the number of threads for decoding.
+   *
+   * @param threads Number of threads, including the thread which
+   * calls process_packet()
+   *
+   * Channel groups of audio chunks are decoded in parallel by a
+   * worker pool. The threads are created here, for up to
+   * NETAUDIO_MAX_CHANNELS channels, and are only repartitioned when
+   * a header with a different number of channels is received. Call
+   * before processing packets.
+   */
+  void set_threads(size_t threads);
+  /// True if a valid header was received
+  bool has_info() const { return info_valid; };
+  /// Stream information from the last valid header
+  const netaudio_info_t& get_info() const { return info; };
+  /// Position of the latest audio chunk on the 64-bit sample timeline
+  uint64_t get_timeline() const { return timeline; };
+  /// Estimate of the sender sampling rate in Hz
+  double get_srate_estimate() const { return w_samplecnt / w_duration; };
+  /// Number of received packets
+  size_t get_packets() const { return packets; };
+  /// Number of valid header packets
+  size_t get_headers() const { return headers; };
+  /// Number of valid audio chunks
+  size_t get_chunks() const { return chunks; };
+  /// Number of audio chunks which arrived out of order
+  size_t get_reordered() const { return reordered; };
+  /// Number of packets which could not be decoded
+  size_t get_errors() const { return errors; };
+  /// Interarrival jitter in seconds, as in RFC 3550
+  double get_jitter() const { return jitter; };
+  /**
+   * Create a receiver report of the current stream.
+   *
+   * @param[out] report Receiver report
+   * @return False if no stream is received yet
+   *
+   * The loss rate is the fraction of frames which were lost or
+   * arrived too late for playout since the previous call. The drift
+   * is measured from the timeline progress and the arrival time of
+   * the latest chunk since the previous call. Unlike
+   * get_srate_estimate(), it is not biased by bursts of chunks, and
+   * the errors of consecutive reports cancel out when averaged.
+   */
+  bool get_report(netaudio_report_t& report);
+
+private:
+  ringbuffer_ooowrite_t& jitterbuffer;
+  jitter_controller_t* controller = NULL;
+  worker_pool_t* workers = NULL;
+  netaudio_info_t info;
+  netaudio_codec_t codec;
+  bool info_valid = false;
+  float* audio = NULL;
+  size_t audio_numelem = 0;
+  // position on the 64-bit sample timeline, starts at 2^32 to avoid
+  // negative positions:
+  uint64_t timeline = (uint64_t)1u << 32;
+  bool has_timeline = false;
+  uint32_t prev_sampleidx = 0;
+  uint64_t prev_arrival = 0;
+  // clock estimation:
+  double c = 0.999;
+  double w_samplecnt = 1.0;
+  double w_duration = 1.0;
+  float nominalsrate = -1;
+  // interarrival jitter:
+  double jitter = 0.0;
+  double prev_transit = 0.0;
+  // reception statistics, and their state at the last report:
+  uint64_t highest = 0;
+  uint64_t highest_arrival = 0;
+  size_t received = 0;
+  uint64_t report_highest = 0;
+  uint64_t report_arrival = 0;
+  size_t report_received = 0;
+  size_t report_late = 0;
+  size_t packets = 0;
+  size_t headers = 0;
+  size_t chunks = 0;
+  size_t reordered = 0;
+  size_t errors = 0;
+};
+
+#endif
+
+/*
+ * Local Variables:
+ * mode: c++
+ * c-basic-offset: 2
+ * indent-tabs-mode: nil
+ * compile-command: "make -C .."
+ * End:
+ */
@@ -0,0 +1,42 @@
+/**
+ * @file receiver_fuzz.cc
+ * @brief Fuzzing harness for the packet processing of udpreceive
+ *
+ * The input is a sequence of packets, each preceded by its size as a
+ * 16 bit little-endian number, which are passed to a receiver as in
+ * the receiving thread of udpreceive.
+ */
+
+#include "receiver.h"
+#include <algorithm>
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+  ringbuffer_ooowrite_t jitterbuffer(1024, 2, 256);
+  netaudio_receiver_t receiver(jitterbuffer);
+  float audio[2 * 64];
+  uint64_t arrival(0);
+  while(size >= 2u) {
+    size_t len(data[0] | (data[1] << 8));
+    data += 2;
+    size -= 2u;
+    len = std::min(len, size);
+    receiver.process_packet((const char*)data, len, arrival);
+    data += len;
+    size -= len;
+    arrival += 1000000u;
+    jitterbuffer.read_data(audio, 64, 2);
+    netaudio_report_t report;
+    receiver.get_report(report);
+  }
+  return 0;
+}
+
+/*
+ * Local Variables:
+ * mode: c++
+ * c-basic-offset: 2
+ * indent-tabs-mode: nil
+ * compile-command: "make -C .. fuzzers"
+ * End:
+ */
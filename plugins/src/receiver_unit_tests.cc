@@ -0,0 +1,175 @@
+#include <gtest/gtest.h>
+
+#include "receiver.h"
+#include <vector>
+
+TEST(receiver, process_packet)
+{
+  const size_t fragsize(16);
+  const size_t channels(2);
+  netaudio_info_t info(new_netaudio_info(32000, pcmfloat, channels, fragsize));
+  ringbuffer_ooowrite_t rb(8 * fragsize, channels);
+  netaudio_receiver_t receiver(rb);
+  char packet[1024];
+  float audio[fragsize * channels];
+  netaudio_err_t err;
+  for(size_t k = 0; k < fragsize * channels; ++k)
+    audio[k] = k;
+  size_t len(encode_audio(info, audio, fragsize * channels, 0xfffffff0u,
+                          packet, sizeof(packet), err));
+  ASSERT_NE(0u, len);
+  // audio is ignored before the first header:
+  EXPECT_EQ(netaudio_not_a_header, receiver.process_packet(packet, len, 0));
+  EXPECT_FALSE(receiver.has_info());
+  EXPECT_EQ(1u, receiver.get_errors());
+  size_t hlen(encode_header(info, packet, sizeof(packet), err));
+  EXPECT_EQ(netaudio_success, receiver.process_packet(packet, hlen, 0));
+  EXPECT_TRUE(receiver.has_info());
+  EXPECT_EQ(2u, receiver.get_info().channels);
+  EXPECT_EQ(32000.0, receiver.get_srate_estimate());
+  // chunks across the sample index wrap-around, every 0.515 ms,
+  // i.e., the sender clock is 3% slower than nominal:
+  uint64_t t(1000000);
+  uint32_t sample_index(0xfffffff0u);
+  for(size_t n = 0; n < 10000; ++n) {
+    len = encode_audio(info, audio, fragsize * channels, sample_index, packet,
+                       sizeof(packet), err);
+    EXPECT_EQ(netaudio_success, receiver.process_packet(packet, len, t));
+    if(n == 0) {
+      EXPECT_EQ(((uint64_t)1u << 32) + 0xfffffff0u, receiver.get_timeline());
+    }
+    sample_index += fragsize;
+    t += 515464;
+  }
+  EXPECT_EQ(((uint64_t)1u << 32) + 0xfffffff0u + 9999 * fragsize,
+            receiver.get_timeline());
+  EXPECT_NEAR(31040.0, receiver.get_srate_estimate(), 10.0);
+  // reordered chunk:
+  len = encode_audio(info, audio, fragsize * channels,
+                     sample_index - 2 * fragsize, packet, sizeof(packet), err);
+  EXPECT_EQ(netaudio_success, receiver.process_packet(packet, len, t));
+  EXPECT_EQ(1u, receiver.get_reordered());
+  EXPECT_EQ(10003u, receiver.get_packets());
+  EXPECT_EQ(1u, receiver.get_headers());
+  EXPECT_EQ(10001u, receiver.get_chunks());
+  EXPECT_EQ(1u, receiver.get_errors());
+  // decoded audio is in the jitter buffer:
+  float out[fragsize * channels];
+  EXPECT_EQ(fragsize, rb.read_data(out, fragsize, channels));
+}
+
+TEST(receiver, threads)
+{
+  // parallel decoding of channel groups:
+  const size_t fragsize(16);
+  const size_t channels(48);
+  netaudio_info_t info(new_netaudio_info(48000, pcm16bit, channels, fragsize));
+  ringbuffer_ooowrite_t rb(8 * fragsize, channels);
+  netaudio_receiver_t receiver(rb);
+  receiver.set_threads(3);
+  std::vector<char> packet(get_buffer_length(info));
+  std::vector<float> audio(fragsize * channels);
+  netaudio_err_t err;
+  for(size_t k = 0; k < audio.size(); ++k)
+    audio[k] = 0.001f * k;
+  size_t len(encode_header(info, packet.data(), packet.size(), err));
+  EXPECT_EQ(netaudio_success, receiver.process_packet(packet.data(), len, 0));
+  len = encode_audio(info, audio.data(), audio.size(), 1000, packet.data(),
+                     packet.size(), err);
+  EXPECT_EQ(netaudio_success, receiver.process_packet(packet.data(), len, 0));
+  EXPECT_EQ(((uint64_t)1u << 32) + 1000u, receiver.get_timeline());
+  std::vector<float> out(fragsize * channels);
+  EXPECT_EQ(fragsize, rb.read_data(out.data(), fragsize, channels));
+  for(size_t k = 0; k < audio.size(); ++k)
+    EXPECT_NEAR(audio[k], out[k], 1.0f / 32767.0f) << k;
+  // errors are reported by the first group:
+  packet[1]++;
+  EXPECT_EQ(netaudio_invalid_checksum,
+            receiver.process_packet(packet.data(), len, 0));
+  // a header with a different number of channels repartitions the pool:
+  netaudio_info_t info2(new_netaudio_info(48000, pcm16bit, 20, fragsize));
+  ringbuffer_ooowrite_t rb2(8 * fragsize, 20);
+  netaudio_receiver_t receiver2(rb2);
+  receiver2.set_threads(3);
+  len = encode_header(info, packet.data(), packet.size(), err);
+  EXPECT_EQ(netaudio_success, receiver2.process_packet(packet.data(), len, 0));
+  len = encode_header(info2, packet.data(), packet.size(), err);
+  EXPECT_EQ(netaudio_success, receiver2.process_packet(packet.data(), len, 0));
+  len = encode_audio(info2, audio.data(), 20 * fragsize, 0, packet.data(),
+                     packet.size(), err);
+  EXPECT_EQ(netaudio_success, receiver2.process_packet(packet.data(), len, 0));
+  EXPECT_EQ(fragsize, rb2.read_data(out.data(), fragsize, 20));
+  for(size_t k = 0; k < 20 * fragsize; ++k)
+    EXPECT_NEAR(audio[k], out[k], 1.0f / 32767.0f) << k;
+}
+
+TEST(receiver, threads_channel_change)
+{
+  // a different number of channels with the same chunk size:
+  netaudio_info_t info(new_netaudio_info(48000, pcm16bit, 32, 64));
+  netaudio_info_t info2(new_netaudio_info(48000, pcm16bit, 64, 32));
+  ringbuffer_ooowrite_t rb(8 * 32, 64);
+  netaudio_receiver_t receiver(rb);
+  receiver.set_threads(4);
+  std::vector<char> packet(get_buffer_length(info2));
+  std::vector<float> audio(32 * 64);
+  netaudio_err_t err;
+  for(size_t k = 0; k < audio.size(); ++k)
+    audio[k] = 0.0001f * k;
+  size_t len(encode_header(info, packet.data(), packet.size(), err));
+  EXPECT_EQ(netaudio_success, receiver.process_packet(packet.data(), len, 0));
+  len = encode_header(info2, packet.data(), packet.size(), err);
+  EXPECT_EQ(netaudio_success, receiver.process_packet(packet.data(), len, 0));
+  len = encode_audio(info2, audio.data(), audio.size(), 0, packet.data(),
+                     packet.size(), err);
+  EXPECT_EQ(netaudio_success, receiver.process_packet(packet.data(), len, 0));
+  std::vector<float> out(audio.size());
+  EXPECT_EQ(32u, rb.read_data(out.data(), 32, 64));
+  for(size_t k = 0; k < audio.size(); ++k)
+    ASSERT_NEAR(audio[k], out[k], 1.0f / 32767.0f) << k;
+}
+
+TEST(receiver, get_report)
+{
+  const size_t fragsize(16);
+  const size_t channels(1);
+  netaudio_info_t info(new_netaudio_info(16000, pcm16bit, channels, fragsize));
+  ringbuffer_ooowrite_t rb(64 * fragsize, channels);
+  netaudio_receiver_t receiver(rb);
+  netaudio_report_t report;
+  EXPECT_FALSE(receiver.get_report(report));
+  char packet[1024];
+  float audio[fragsize * channels] = {0};
+  netaudio_err_t err;
+  size_t len(encode_header(info, packet, sizeof(packet), err));
+  receiver.process_packet(packet, len, 0);
+  // every fifth chunk is lost, arrival with 1 ms period:
+  uint32_t sample_index(1000);
+  uint64_t t(1000000);
+  for(size_t n = 0; n < 21; ++n) {
+    if(n % 5 != 4) {
+      len = encode_audio(info, audio, fragsize * channels, sample_index, packet,
+                         sizeof(packet), err);
+      EXPECT_EQ(netaudio_success, receiver.process_packet(packet, len, t));
+    }
+    sample_index += fragsize;
+    t += 1000000;
+  }
+  ASSERT_TRUE(receiver.get_report(report));
+  EXPECT_EQ(info.chksum, report.chksum);
+  EXPECT_EQ(sample_index, report.sample_index);
+  EXPECT_NEAR(4.0f / 20.0f, report.loss, 1e-6f);
+  EXPECT_NEAR(0.0f, report.jitter, 1e-6f);
+  EXPECT_NEAR(21.0f * fragsize / 16000.0f, report.buffer, 1e-6f);
+  EXPECT_NEAR(0.0f, report.drift, 1e-3f);
+  // no chunks since last report:
+  ASSERT_TRUE(receiver.get_report(report));
+  EXPECT_EQ(0.0f, report.loss);
+}
+
+// Local Variables:
+// compile-command: "make -C .. unit-tests"
+// coding: utf-8-unix
+// c-basic-offset: 2
+// indent-tabs-mode: nil
+// End:
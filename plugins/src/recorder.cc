@@ -0,0 +1,264 @@
+#include "recorder.h"
+#include "netaudio_codec.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdexcept>
+#include <string.h>
+#include <unistd.h>
+
+// size of file writes, a multiple of the alignment:
+#define RECORDER_WRITE_SIZE (1u << 20)
+// alignment of file writes and buffers for direct I/O:
+#define RECORDER_ALIGN 4096u
+// polling period of the writer thread:
+#define RECORDER_POLL_USEC 10000u
+// header sizes of the container formats:
+#define RECORDER_WAV_HEADER 80u
+#define RECORDER_CAF_HEADER 68u
+
+static void store_be16(char* p, uint16_t v)
+{
+  p[0] = (char)(v >> 8);
+  p[1] = (char)v;
+}
+
+static void store_be32(char* p, uint32_t v)
+{
+  store_be16(p, v >> 16);
+  store_be16(&(p[2]), v);
+}
+
+static void store_be64(char* p, uint64_t v)
+{
+  store_be32(p, v >> 32);
+  store_be32(&(p[4]), v);
+}
+
+static bool ends_with(const std::string& s, const std::string& suffix)
+{
+  return (s.size() >= suffix.size()) &&
+         (s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0);
+}
+
+recorder_t::recorder_t(const std::string& path, double srate, size_t channels,
+                       size_t blocksize, size_t blocks, samplefmt_t samplefmt)
+    : container(wav), srate(srate), channels(channels), blocksize(blocksize),
+      blocks(std::max((size_t)1u, blocks)), samplefmt(samplefmt),
+      samplesize((samplefmt == pcmfloat) ? sizeof(float) : sizeof(int16_t)),
+      fd(-1), direct(false), fifo(this->blocks * blocksize * channels),
+      staging(NULL), staged(0)
+{
+  if(ends_with(path, ".caf"))
+    container = caf;
+  else if(ends_with(path, ".rf64"))
+    container = rf64;
+  int flags(O_WRONLY | O_CREAT | O_TRUNC);
+#ifdef O_DIRECT
+  fd = open(path.c_str(), flags | O_DIRECT, 0644);
+  direct = (fd >= 0);
+  // some file systems, e.g., tmpfs, do not support direct I/O:
+  if((fd < 0) && (errno == EINVAL))
+#endif
+    fd = open(path.c_str(), flags, 0644);
+  if(fd < 0)
+    throw std::runtime_error("Unable to create recording file \"" + path +
+                             "\": " + strerror(errno));
+  if(posix_memalign((void**)&staging, RECORDER_ALIGN, RECORDER_WRITE_SIZE)) {
+    close(fd);
+    throw std::runtime_error("Unable to allocate recording buffer.");
+  }
+  // the header is written with the first block, and updated at the
+  // end:
+  staged = make_header(staging);
+  writer = std::thread(&recorder_t::writesrv, this);
+}
+
+recorder_t::~recorder_t()
+{
+  run = false;
+  writer.join();
+  flush(true);
+  char header[RECORDER_WAV_HEADER];
+  size_t len(make_header(header));
+  if(!error && (pwrite(fd, header, len, 0) != (ssize_t)len))
+    error = true;
+  close(fd);
+  free(staging);
+}
+
+float* recorder_t::borrow()
+{
+  uint64_t h(head.load(std::memory_order_relaxed));
+  if(h - tail.load(std::memory_order_acquire) >= blocks) {
+    ++dropped;
+    return NULL;
+  }
+  return &(fifo[(h % blocks) * blocksize * channels]);
+}
+
+void recorder_t::commit()
+{
+  head.store(head.load(std::memory_order_relaxed) + 1u,
+             std::memory_order_release);
+}
+
+void recorder_t::writesrv()
+{
+  while(true) {
+    // blocks committed before the end of recording are written:
+    bool stop(!run);
+    uint64_t t(tail.load(std::memory_order_relaxed));
+    uint64_t h(head.load(std::memory_order_acquire));
+    for(; t != h; ++t) {
+      write_block(&(fifo[(t % blocks) * blocksize * channels]));
+      tail.store(t + 1u, std::memory_order_release);
+    }
+    if(stop)
+      return;
+    usleep(RECORDER_POLL_USEC);
+  }
+}
+
+void recorder_t::write_block(const float* audio)
+{
+  if(error)
+    return;
+  // the encoders of the netaudio protocol produce little-endian
+  // samples, as in WAV files and CAF files with the little-endian
+  // flag; blocks which do not fit into the staging buffer are split
+  // at frame boundaries:
+  size_t framesize(channels * samplesize);
+  size_t done(0);
+  while(done < blocksize) {
+    size_t n(std::min(blocksize - done,
+                      (RECORDER_WRITE_SIZE - staged) / framesize));
+    if(n == 0u) {
+      // less than one frame left, frames may span two writes:
+      char frame[NETAUDIO_MAX_CHANNELS * sizeof(float)];
+      char* dest(frame);
+      std::vector<char> large;
+      if(framesize > sizeof(frame)) {
+        large.resize(framesize);
+        dest = large.data();
+      }
+      if(samplefmt == pcmfloat)
+        encode_samples<pcmfloat, 0>(&(audio[done * channels]), 1u, channels,
+                                    dest);
+      else
+        encode_samples<pcm16bit, 0>(&(audio[done * channels]), 1u, channels,
+                                    dest);
+      size_t part(RECORDER_WRITE_SIZE - staged);
+      memcpy(&(staging[staged]), dest, part);
+      staged += part;
+      flush(false);
+      memcpy(staging, &(dest[part]), framesize - part);
+      staged = framesize - part;
+      ++done;
+      continue;
+    }
+    if(samplefmt == pcmfloat)
+      encode_samples<pcmfloat, 0>(&(audio[done * channels]), n, channels,
+                                  &(staging[staged]));
+    else
+      encode_samples<pcm16bit, 0>(&(audio[done * channels]), n, channels,
+                                  &(staging[staged]));
+    staged += n * framesize;
+    done += n;
+    if(staged == RECORDER_WRITE_SIZE)
+      flush(false);
+  }
+  frames += blocksize;
+}
+
+void recorder_t::flush(bool final)
+{
+#ifdef O_DIRECT
+  // the last write is not a multiple of the alignment:
+  if(final && direct) {
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_DIRECT);
+    direct = false;
+  }
+#endif
+  size_t pos(0);
+  while(!error && (pos < staged)) {
+    ssize_t n(::write(fd, &(staging[pos]), staged - pos));
+    if(n < 0) {
+      if(errno == EINTR)
+        continue;
+#ifdef O_DIRECT
+      // file systems may accept O_DIRECT when opening, but not writing:
+      if((errno == EINVAL) && direct) {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_DIRECT);
+        direct = false;
+        continue;
+      }
+#endif
+      error = true;
+    } else {
+      pos += n;
+    }
+  }
+  staged = 0;
+}
+
+size_t recorder_t::make_header(char* data) const
+{
+  uint64_t datalen(frames * channels * samplesize);
+  if(container == caf) {
+    memset(data, 0, RECORDER_CAF_HEADER);
+    memcpy(data, "caff", 4);
+    store_be16(&(data[4]), 1u);
+    memcpy(&(data[8]), "desc", 4);
+    store_be64(&(data[12]), 32u);
+    uint64_t srate_bits;
+    double srate_d(srate);
+    memcpy(&srate_bits, &srate_d, sizeof(srate_bits));
+    store_be64(&(data[20]), srate_bits);
+    memcpy(&(data[28]), "lpcm", 4);
+    // kCAFLinearPCMFormatFlagIsFloat, kCAFLinearPCMFormatFlagIsLittleEndian:
+    store_be32(&(data[32]), ((samplefmt == pcmfloat) ? 1u : 0u) | 2u);
+    store_be32(&(data[36]), channels * samplesize);
+    store_be32(&(data[40]), 1u);
+    store_be32(&(data[44]), channels);
+    store_be32(&(data[48]), 8u * samplesize);
+    memcpy(&(data[52]), "data", 4);
+    // the size is unknown while recording, including the edit count:
+    store_be64(&(data[56]), frames ? datalen + 4u : (uint64_t)-1);
+    return RECORDER_CAF_HEADER;
+  }
+  memset(data, 0, RECORDER_WAV_HEADER);
+  uint64_t riffsize(RECORDER_WAV_HEADER - 8u + datalen);
+  bool large((container == rf64) || (riffsize > 0xffffffffu));
+  memcpy(data, large ? "RF64" : "RIFF", 4);
+  store_le32(&(data[4]), large ? 0xffffffffu : riffsize);
+  memcpy(&(data[8]), "WAVE", 4);
+  // ds64 chunk, or JUNK chunk of the same size:
+  memcpy(&(data[12]), large ? "ds64" : "JUNK", 4);
+  store_le32(&(data[16]), 28u);
+  if(large) {
+    store_le64(&(data[20]), riffsize);
+    store_le64(&(data[28]), datalen);
+    store_le64(&(data[36]), frames);
+  }
+  memcpy(&(data[48]), "fmt ", 4);
+  store_le32(&(data[52]), 16u);
+  // WAVE_FORMAT_IEEE_FLOAT or WAVE_FORMAT_PCM:
+  store_le16(&(data[56]), (samplefmt == pcmfloat) ? 3u : 1u);
+  store_le16(&(data[58]), channels);
+  store_le32(&(data[60]), srate);
+  store_le32(&(data[64]), srate * channels * samplesize);
+  store_le16(&(data[68]), channels * samplesize);
+  store_le16(&(data[70]), 8u * samplesize);
+  memcpy(&(data[72]), "data", 4);
+  store_le32(&(data[76]), large ? 0xffffffffu : datalen);
+  return RECORDER_WAV_HEADER;
+}
+
+/*
+ * Local Variables:
+ * mode: c++
+ * c-basic-offset: 2
+ * indent-tabs-mode: nil
+ * compile-command: "make -C .."
+ * End:
+ */
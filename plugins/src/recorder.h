@@ -0,0 +1,103 @@
+/**
+ * @file recorder.h
+ * @brief Recording of audio streams to sound files
+ */
+
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include "netaudio.h"
+#include <atomic>
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Record interleaved audio blocks to a WAV, RF64 or CAF file
+ *
+ * The audio thread borrows a block from a FIFO, writes the audio
+ * directly into it and commits it, so recording needs no copy on
+ * the audio thread. A writer thread converts the blocks to the file
+ * sample format and writes them in large blocks, which are aligned
+ * for direct I/O (O_DIRECT) where the file system supports it.
+ *
+ * The container format is selected by the file name extension:
+ * ".caf" for Core Audio Format, ".rf64" for RF64, and WAV
+ * otherwise. WAV files contain a JUNK chunk which is replaced by a
+ * ds64 chunk if the file exceeds 4 GB, i.e., they are converted to
+ * RF64 as proposed by EBU Tech 3306. Header sizes are written when
+ * the recorder is deleted.
+ */
+class recorder_t {
+public:
+  /**
+   * @param path File name, an existing file is replaced
+   * @param srate Sampling rate in Hz
+   * @param channels Number of channels
+   * @param blocksize Frames per block
+   * @param blocks Capacity of FIFO in blocks
+   * @param samplefmt Sample format of file
+   */
+  recorder_t(const std::string& path, double srate, size_t channels,
+             size_t blocksize, size_t blocks, samplefmt_t samplefmt);
+  ~recorder_t();
+  /**
+   * Borrow a block, to be called by the audio thread.
+   *
+   * @return Buffer for blocksize interleaved frames, or NULL if the
+   * FIFO is full
+   */
+  float* borrow();
+  /**
+   * Commit the block returned by the last call of borrow().
+   */
+  void commit();
+  /// Number of blocks which were not recorded because the FIFO was full
+  size_t get_dropped() const { return dropped; };
+  /// Number of frames written to the file
+  uint64_t get_frames() const { return frames; };
+  /// True if writing to the file failed; recording is then stopped
+  bool get_error() const { return error; };
+  /// True if the file is written with direct I/O
+  bool get_direct() const { return direct; };
+
+private:
+  void writesrv();
+  void write_block(const float* audio);
+  void flush(bool final);
+  size_t make_header(char* data) const;
+  enum container_t { wav, rf64, caf };
+  container_t container;
+  double srate;
+  size_t channels;
+  size_t blocksize;
+  size_t blocks;
+  samplefmt_t samplefmt;
+  size_t samplesize;
+  int fd;
+  std::atomic_bool direct;
+  // FIFO of audio blocks:
+  std::vector<float> fifo;
+  std::atomic<uint64_t> head = 0;
+  std::atomic<uint64_t> tail = 0;
+  std::atomic<size_t> dropped = 0;
+  // aligned staging buffer of the writer thread:
+  char* staging;
+  size_t staged;
+  std::atomic<uint64_t> frames = 0;
+  std::atomic_bool error = false;
+  std::atomic_bool run = true;
+  std::thread writer;
+};
+
+#endif
+
+/*
+ * Local Variables:
+ * mode: c++
+ * c-basic-offset: 2
+ * indent-tabs-mode: nil
+ * compile-command: "make -C .."
+ * End:
+ */
@@ -0,0 +1,133 @@
+#include <gtest/gtest.h>
+
+#include "netaudio_wire.h"
+#include "recorder.h"
+#include <fstream>
+#include <iterator>
+#include <unistd.h>
+
+static std::vector<char> record(const std::string& path, samplefmt_t fmt,
+                                size_t channels, size_t blocksize,
+                                size_t numblocks)
+{
+  {
+    recorder_t rec(path, 44100, channels, blocksize, 256, fmt);
+    for(size_t n = 0; n < numblocks; ++n) {
+      float* buf(NULL);
+      while(!(buf = rec.borrow()))
+        usleep(1000);
+      for(size_t k = 0; k < blocksize; ++k)
+        for(size_t c = 0; c < channels; ++c)
+          buf[k * channels + c] =
+              (float)((n * blocksize + k + c) % 1000u) / 1000.0f;
+      rec.commit();
+    }
+  }
+  std::ifstream f(path, std::ios::binary);
+  std::vector<char> data((std::istreambuf_iterator<char>(f)),
+                         std::istreambuf_iterator<char>());
+  unlink(path.c_str());
+  return data;
+}
+
+static void check_samples(const char* data, samplefmt_t fmt, size_t channels,
+                          size_t frames)
+{
+  for(size_t k = 0; k < frames; ++k)
+    for(size_t c = 0; c < channels; ++c) {
+      float v((float)((k + c) % 1000u) / 1000.0f);
+      size_t i(k * channels + c);
+      if(fmt == pcmfloat)
+        ASSERT_EQ(v, load_lefloat(&(data[4 * i])));
+      else
+        ASSERT_NEAR(v * 32767.0f, (int16_t)load_le16(&(data[2 * i])), 0.51f);
+    }
+}
+
+TEST(recorder, wav)
+{
+  // more than one write of the staging buffer, with frames spanning
+  // two writes:
+  const size_t channels(3);
+  const size_t blocksize(64);
+  const size_t numblocks(3000);
+  const size_t frames(blocksize * numblocks);
+  std::string path("/tmp/recorder_test_" + std::to_string(getpid()));
+  for(samplefmt_t fmt : {pcm16bit, pcmfloat}) {
+    size_t samplesize((fmt == pcmfloat) ? 4u : 2u);
+    std::vector<char> data(
+        record(path + ".wav", fmt, channels, blocksize, numblocks));
+    size_t datalen(frames * channels * samplesize);
+    ASSERT_EQ(80u + datalen, data.size());
+    EXPECT_EQ(0, memcmp(data.data(), "RIFF", 4));
+    EXPECT_EQ(72u + datalen, load_le32(&(data[4])));
+    EXPECT_EQ(0, memcmp(&(data[8]), "WAVEJUNK", 8));
+    EXPECT_EQ(28u, load_le32(&(data[16])));
+    EXPECT_EQ(0, memcmp(&(data[48]), "fmt ", 4));
+    EXPECT_EQ(16u, load_le32(&(data[52])));
+    EXPECT_EQ((fmt == pcmfloat) ? 3u : 1u, load_le16(&(data[56])));
+    EXPECT_EQ(channels, load_le16(&(data[58])));
+    EXPECT_EQ(44100u, load_le32(&(data[60])));
+    EXPECT_EQ(44100u * channels * samplesize, load_le32(&(data[64])));
+    EXPECT_EQ(channels * samplesize, load_le16(&(data[68])));
+    EXPECT_EQ(8u * samplesize, load_le16(&(data[70])));
+    EXPECT_EQ(0, memcmp(&(data[72]), "data", 4));
+    EXPECT_EQ(datalen, load_le32(&(data[76])));
+    check_samples(&(data[80]), fmt, channels, frames);
+  }
+}
+
+TEST(recorder, rf64)
+{
+  const size_t channels(2);
+  const size_t frames(64 * 100);
+  std::string path("/tmp/recorder_test_" + std::to_string(getpid()) + ".rf64");
+  std::vector<char> data(record(path, pcm16bit, channels, 64, 100));
+  size_t datalen(frames * channels * 2u);
+  ASSERT_EQ(80u + datalen, data.size());
+  EXPECT_EQ(0, memcmp(data.data(), "RF64", 4));
+  EXPECT_EQ(0xffffffffu, load_le32(&(data[4])));
+  EXPECT_EQ(0, memcmp(&(data[8]), "WAVEds64", 8));
+  EXPECT_EQ(72u + datalen, load_le64(&(data[20])));
+  EXPECT_EQ(datalen, load_le64(&(data[28])));
+  EXPECT_EQ(frames, load_le64(&(data[36])));
+  EXPECT_EQ(0, memcmp(&(data[72]), "data", 4));
+  EXPECT_EQ(0xffffffffu, load_le32(&(data[76])));
+  check_samples(&(data[80]), pcm16bit, channels, frames);
+}
+
+TEST(recorder, caf)
+{
+  const size_t channels(2);
+  const size_t frames(64 * 100);
+  std::string path("/tmp/recorder_test_" + std::to_string(getpid()) + ".caf");
+  std::vector<char> data(record(path, pcmfloat, channels, 64, 100));
+  size_t datalen(frames * channels * 4u);
+  ASSERT_EQ(68u + datalen, data.size());
+  const uint8_t* p((const uint8_t*)data.data());
+  EXPECT_EQ(0, memcmp(p, "caff\0\1\0\0desc", 12));
+  // big-endian chunk size, sampling rate, format and flags:
+  EXPECT_EQ(32u, p[19]);
+  EXPECT_EQ(0x40u, p[20]);
+  EXPECT_EQ(0xe5u, p[21]);
+  EXPECT_EQ(0x88u, p[22]);
+  EXPECT_EQ(0, memcmp(&(p[28]), "lpcm", 4));
+  EXPECT_EQ(3u, p[35]);
+  EXPECT_EQ(8u, p[39]);
+  EXPECT_EQ(1u, p[43]);
+  EXPECT_EQ(2u, p[47]);
+  EXPECT_EQ(32u, p[51]);
+  EXPECT_EQ(0, memcmp(&(p[52]), "data", 4));
+  uint64_t size(0);
+  for(size_t k = 0; k < 8; ++k)
+    size = (size << 8) | p[56 + k];
+  EXPECT_EQ(datalen + 4u, size);
+  check_samples(&(data[68]), pcmfloat, channels, frames);
+}
+
+// Local Variables:
+// compile-command: "make -C .. unit-tests"
+// coding: utf-8-unix
+// c-basic-offset: 2
+// indent-tabs-mode: nil
+// End:
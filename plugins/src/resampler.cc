@@ -0,0 +1,55 @@
+#include "resampler.h"
+#include <math.h>
+#include <string.h>
+
+// number of past input frames needed for interpolation:
+#define RESAMPLER_HISTORY 4u
+
+resampler_t::resampler_t(size_t channels, size_t maxframes, double maxstretch)
+    : channels(channels), maxstretch(std::min(0.5, fabs(maxstretch))),
+      buf((RESAMPLER_HISTORY + 1u +
+           (size_t)ceil(maxframes * (1.0 + this->maxstretch))) *
+          channels)
+{
+}
+
+size_t resampler_t::read(ringbuffer_ooowrite_t& src, float* audio,
+                         size_t frames, double ratio)
+{
+  ratio = std::max(1.0 - maxstretch, std::min(1.0 + maxstretch, ratio));
+  size_t nin(floor(frac + frames * ratio));
+  float* in(&(buf[RESAMPLER_HISTORY * channels]));
+  size_t valid(src.read_data(in, nin, channels));
+  // output frame j is interpolated between input frames i-3 and i-2,
+  // with i = floor(frac + j * ratio), which are in buf at i+1 and i+2:
+  for(size_t j = 0; j < frames; ++j) {
+    double x(frac + j * ratio);
+    size_t i(floor(x));
+    float t(x - i);
+    const float* y(&(buf[i * channels]));
+    float* dest(&(audio[j * channels]));
+    for(size_t c = 0; c < channels; ++c) {
+      float y0(y[c]);
+      float y1(y[c + channels]);
+      float y2(y[c + 2 * channels]);
+      float y3(y[c + 3 * channels]);
+      float c1(0.5f * (y2 - y0));
+      float c2(y0 - 2.5f * y1 + 2.0f * y2 - 0.5f * y3);
+      float c3(0.5f * (y3 - y0) + 1.5f * (y1 - y2));
+      dest[c] = ((c3 * t + c2) * t + c1) * t + y1;
+    }
+  }
+  frac += frames * ratio - nin;
+  memmove(buf.data(), &(buf[nin * channels]),
+          sizeof(float) * RESAMPLER_HISTORY * channels);
+  return valid;
+}
+
+/*
+ * Local Variables:
+ * mode: c++
+ * c-basic-offset: 2
+ * indent-tabs-mode: nil
+ * compile-command: "make -C .."
+ * End:
+ */
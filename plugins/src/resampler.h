@@ -0,0 +1,60 @@
+/**
+ * @file resampler.h
+ * @brief Variable ratio resampling of jitter buffer output
+ */
+
+#ifndef RESAMPLER_H
+#define RESAMPLER_H
+
+#include "ringbuffer.h"
+#include <vector>
+
+/**
+ * @brief Read from a jitter buffer with a variable resampling ratio
+ *
+ * The ratio of input frames to output frames can be changed with
+ * every read, e.g., to steer the fill level of the jitter buffer
+ * without audible discontinuities. Samples are interpolated with
+ * cubic Hermite splines, which adds a delay of three frames.
+ */
+class resampler_t {
+public:
+  /**
+   * @param channels Number of channels
+   * @param maxframes Maximum number of output frames per read
+   * @param maxstretch Maximum deviation of the ratio from one
+   */
+  resampler_t(size_t channels, size_t maxframes, double maxstretch = 0.01);
+  /**
+   * Read resampled frames.
+   *
+   * @param src Jitter buffer to read from
+   * @param audio Buffer for interleaved output samples
+   * @param frames Number of output frames, at most maxframes
+   * @param ratio Input frames per output frame, limited to
+   * 1 +/- maxstretch
+   * @return Number of valid input frames read from src
+   */
+  size_t read(ringbuffer_ooowrite_t& src, float* audio, size_t frames,
+              double ratio);
+
+private:
+  size_t channels;
+  double maxstretch;
+  // position of the next output frame, relative to the first new
+  // input frame:
+  double frac = 0.0;
+  // history and new input frames:
+  std::vector<float> buf;
+};
+
+#endif
+
+/*
+ * Local Variables:
+ * mode: c++
+ * c-basic-offset: 2
+ * indent-tabs-mode: nil
+ * compile-command: "make -C .."
+ * End:
+ */
@@ -0,0 +1,33 @@
+#include <benchmark/benchmark.h>
+
+#include "resampler.h"
+#include <vector>
+
+// Resample one block from a jitter buffer, with a ratio slightly
+// above one as in adaptive playout. The time includes writing the
+// input into the jitter buffer, see BM_ringbuffer_write_read:
+static void BM_resampler_read(benchmark::State& state)
+{
+  size_t channels(state.range(0));
+  size_t frames(state.range(1));
+  ringbuffer_ooowrite_t rb(16 * frames, channels, 4 * frames);
+  resampler_t resampler(channels, frames);
+  std::vector<float> audio(channels * frames, 0.25f);
+  uint64_t sample_index(0);
+  for(auto _ : state) {
+    while(rb.rspace() < 2 * frames) {
+      rb.write_data(audio.data(), frames, channels, sample_index);
+      sample_index += frames;
+    }
+    resampler.read(rb, audio.data(), frames, 1.001);
+  }
+  state.SetItemsProcessed(state.iterations() * channels * frames);
+}
+BENCHMARK(BM_resampler_read)->ArgsProduct({{1, 2, 8, 32, 128}, {64}});
+
+// Local Variables:
+// compile-command: "make -C .. benchmarks"
+// coding: utf-8-unix
+// c-basic-offset: 2
+// indent-tabs-mode: nil
+// End:
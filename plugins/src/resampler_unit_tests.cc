@@ -0,0 +1,60 @@
+#include <gtest/gtest.h>
+
+#include "resampler.h"
+#include <math.h>
+
+TEST(resampler, unity_ratio)
+{
+  const size_t channels(2);
+  ringbuffer_ooowrite_t rb(256, channels);
+  resampler_t resampler(channels, 16);
+  float audio[32 * channels];
+  for(size_t k = 0; k < 32; ++k)
+    for(size_t c = 0; c < channels; ++c)
+      audio[k * channels + c] = k + 100.0f * c;
+  rb.write_data(audio, 32, channels, 1000);
+  float out[16 * channels];
+  EXPECT_EQ(16u, resampler.read(rb, out, 16, 1.0));
+  // delay of three frames:
+  for(size_t c = 0; c < channels; ++c) {
+    for(size_t k = 0; k < 3; ++k)
+      EXPECT_EQ(0.0f, out[k * channels + c]);
+    for(size_t k = 3; k < 16; ++k)
+      EXPECT_EQ(k - 3 + 100.0f * c, out[k * channels + c]);
+  }
+  EXPECT_EQ(16u, resampler.read(rb, out, 16, 1.0));
+  for(size_t k = 0; k < 16; ++k)
+    EXPECT_EQ(k + 13.0f, out[k * channels]);
+}
+
+TEST(resampler, ratio)
+{
+  ringbuffer_ooowrite_t rb(4096, 1);
+  resampler_t resampler(1, 64, 0.01);
+  float audio[2048];
+  // cubic interpolation is exact for quadratic signals:
+  for(size_t k = 0; k < 2048; ++k)
+    audio[k] = 0.001f * k * k;
+  rb.write_data(audio, 2048, 1, 0);
+  float out[64];
+  size_t nin(0);
+  // ratio is limited to maxstretch:
+  for(size_t n = 0; n < 20; ++n) {
+    nin += resampler.read(rb, out, 64, 1.5);
+    for(size_t k = 0; k < 64; ++k) {
+      double x(1.01 * (n * 64 + k) - 3.0);
+      if(x >= 1.0) {
+        ASSERT_NEAR(0.001 * x * x, out[k], 1e-3 * x);
+      }
+    }
+  }
+  EXPECT_EQ((size_t)(1.01 * 20 * 64), nin);
+  EXPECT_EQ(nin, rb.get_read_pos());
+}
+
+// Local Variables:
+// compile-command: "make -C .. unit-tests"
+// coding: utf-8-unix
+// c-basic-offset: 2
+// indent-tabs-mode: nil
+// End:
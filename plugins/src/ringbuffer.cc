@@ -0,0 +1,113 @@
+#include "ringbuffer.h"
+#include <string.h>
+
+// number of consecutive chunks outside of the buffer window before
+// the read position is moved to the new stream position:
+#define RESYNC_CHUNKS 4
+
+ringbuffer_ooowrite_t::ringbuffer_ooowrite_t(size_t frames, size_t channels,
+                                             size_t delay)
+    : frames(std::max((size_t)1u, frames)), channels(channels),
+      delay(std::min(delay, this->frames - 1u))
+{
+  data = new float[std::max((size_t)1u, this->frames * channels)]();
+}
+
+ringbuffer_ooowrite_t::~ringbuffer_ooowrite_t()
+{
+  delete[] data;
+}
+
+void ringbuffer_ooowrite_t::write_data(const float* audio, size_t wframes,
+                                       size_t wchannels, uint64_t sample_index)
+{
+  if(!synced) {
+    rpos = sample_index - delay;
+    wpos = sample_index - delay;
+    synced = true;
+  }
+  uint64_t r(resync ? resync_pos.load() : rpos.load());
+  // all positions are compared with signed differences, to allow for
+  // wrapping of the 64-bit timeline:
+  int64_t ahead(sample_index - r);
+  if((ahead + (int64_t)wframes <= -(int64_t)frames) ||
+     (ahead >= (int64_t)frames)) {
+    // chunk is far outside of the buffer window, probably a new stream:
+    if(++outside_cnt < RESYNC_CHUNKS)
+      return;
+    outside_cnt = 0;
+    r = sample_index - delay;
+    wpos = r;
+    resync_pos = r;
+    resync = true;
+  } else {
+    outside_cnt = 0;
+  }
+  // clear gap between latest frame and this chunk, which may be
+  // filled by reordered chunks later:
+  uint64_t w(wpos);
+  uint64_t t0(((int64_t)(w - r) < 0) ? r : w);
+  for(uint64_t t = t0; (int64_t)(t - sample_index) < 0; ++t) {
+    if((int64_t)(t - r) >= (int64_t)frames)
+      break;
+    memset(&(data[(t % frames) * channels]), 0, sizeof(float) * channels);
+  }
+  size_t nch(std::min(channels, wchannels));
+  uint64_t wend(w);
+  for(size_t k = 0; k < wframes; ++k) {
+    uint64_t t(sample_index + k);
+    int64_t rel(t - r);
+    if(rel < 0) {
+      ++late_frames;
+      continue;
+    }
+    if(rel >= (int64_t)frames)
+      break;
+    float* dest(&(data[(t % frames) * channels]));
+    memcpy(dest, &(audio[k * wchannels]), sizeof(float) * nch);
+    if(nch < channels)
+      memset(&(dest[nch]), 0, sizeof(float) * (channels - nch));
+    if((int64_t)(t - wend) >= 0)
+      wend = t + 1u;
+  }
+  wpos = wend;
+}
+
+size_t ringbuffer_ooowrite_t::read_data(float* audio, size_t rframes,
+                                        size_t rchannels)
+{
+  if(resync.exchange(false))
+    rpos = resync_pos.load();
+  if(!synced) {
+    memset(audio, 0, sizeof(float) * rframes * rchannels);
+    return 0u;
+  }
+  uint64_t r(rpos);
+  uint64_t w(wpos);
+  size_t nch(std::min(channels, rchannels));
+  size_t valid(0);
+  for(size_t k = 0; k < rframes; ++k) {
+    uint64_t t(r + k);
+    float* dest(&(audio[k * rchannels]));
+    if((int64_t)(t - w) < 0) {
+      memcpy(dest, &(data[(t % frames) * channels]), sizeof(float) * nch);
+      if(nch < rchannels)
+        memset(&(dest[nch]), 0, sizeof(float) * (rchannels - nch));
+      ++valid;
+    } else {
+      memset(dest, 0, sizeof(float) * rchannels);
+    }
+  }
+  missing_frames += rframes - valid;
+  rpos = r + rframes;
+  return valid;
+}
+
+/*
+ * Local Variables:
+ * mode: c++
+ * c-basic-offset: 2
+ * indent-tabs-mode: nil
+ * compile-command: "make -C .."
+ * End:
+ */
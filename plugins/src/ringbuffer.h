@@ -0,0 +1,99 @@
+/**
+ * @file ringbuffer.h
+ * @brief Jitter buffer with out-of-order write access
+ */
+
+#ifndef RINGBUFFER_H
+#define RINGBUFFER_H
+
+#include <algorithm>
+#include <atomic>
+#include <stdint.h>
+#include <stdlib.h>
+
+/**
+ * @brief Ring buffer for multichannel audio, written out of order
+ *
+ * The buffer is a window on a 64-bit sample timeline (see
+ * unwrap_sample_index()). Audio chunks are written at their timeline
+ * position, in any order, by one thread. A second thread reads frames
+ * in timeline order. Frames which are not written when they are read
+ * are replaced by zeros. Audio data is stored interleaved.
+ */
+class ringbuffer_ooowrite_t {
+public:
+  /**
+   * @param frames Capacity of buffer in frames
+   * @param channels Number of channels
+   * @param delay Playout delay in frames, relative to the first chunk
+   */
+  ringbuffer_ooowrite_t(size_t frames, size_t channels, size_t delay = 0);
+  ~ringbuffer_ooowrite_t();
+  /**
+   * Write an audio chunk at its timeline position.
+   *
+   * @param audio Interleaved audio samples
+   * @param wframes Number of frames
+   * @param wchannels Number of channels in audio
+   * @param sample_index Timeline position of first frame
+   *
+   * Frames which are already read, or too far ahead of the read
+   * position, are dropped. Missing channels are set to zero, surplus
+   * channels are ignored.
+   */
+  void write_data(const float* audio, size_t wframes, size_t wchannels,
+                  uint64_t sample_index);
+  /**
+   * Read frames in timeline order and advance read position.
+   *
+   * @param audio Buffer for interleaved audio samples
+   * @param rframes Number of frames
+   * @param rchannels Number of channels in audio
+   * @return Number of frames which were written before they were read
+   */
+  size_t read_data(float* audio, size_t rframes, size_t rchannels);
+  /// Number of frames available for reading
+  inline size_t rspace() const
+  {
+    int64_t d(wpos.load() - rpos.load());
+    if(d < 0)
+      return 0u;
+    return std::min((size_t)d, frames);
+  };
+  /// Number of frames which can be written ahead of the latest frame
+  inline size_t wspace() const { return frames - rspace(); };
+  /// Timeline position of the next frame to be read
+  uint64_t get_read_pos() const { return rpos; };
+  /// Timeline position following the latest written frame
+  uint64_t get_write_pos() const { return wpos; };
+  /// Number of frames dropped because they arrived after playout
+  size_t get_late_frames() const { return late_frames; };
+  /// Number of frames which were read before they arrived
+  size_t get_missing_frames() const { return missing_frames; };
+
+private:
+  size_t frames = 1;
+  size_t channels = 1;
+  size_t delay = 0;
+  float* data = NULL;
+  std::atomic<uint64_t> wpos = 0;
+  std::atomic<uint64_t> rpos = 0;
+  std::atomic_bool synced = false;
+  // position requested by the writer after a stream discontinuity:
+  std::atomic<uint64_t> resync_pos = 0;
+  std::atomic_bool resync = false;
+  size_t outside_cnt = 0;
+  std::atomic<size_t> late_frames = 0;
+  std::atomic<size_t> missing_frames = 0;
+};
+
+#endif
+
+/*
+ * Local Variables:
+ * mode: c++
+ * c-basic-offset: 2
+ * indent-tabs-mode: nil
+ * compile-command: "make -C .."
+ * End:
+ */
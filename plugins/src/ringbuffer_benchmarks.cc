@@ -0,0 +1,49 @@
+#include <benchmark/benchmark.h>
+
+#include "ringbuffer.h"
+#include <vector>
+
+// Write one chunk and read it back, as the receiving and the audio
+// thread do for every chunk:
+static void BM_ringbuffer_write_read(benchmark::State& state)
+{
+  size_t channels(state.range(0));
+  size_t frames(state.range(1));
+  ringbuffer_ooowrite_t rb(16 * frames, channels, 4 * frames);
+  std::vector<float> audio(channels * frames, 0.25f);
+  uint64_t sample_index(0);
+  for(auto _ : state) {
+    rb.write_data(audio.data(), frames, channels, sample_index);
+    rb.read_data(audio.data(), frames, channels);
+    sample_index += frames;
+  }
+  state.SetItemsProcessed(state.iterations() * channels * frames);
+}
+BENCHMARK(BM_ringbuffer_write_read)->ArgsProduct({{1, 2, 8, 32}, {64}});
+
+// Pairs of chunks written in reverse order, which clears and fills
+// gaps in the buffer:
+static void BM_ringbuffer_reordered(benchmark::State& state)
+{
+  size_t channels(state.range(0));
+  size_t frames(state.range(1));
+  ringbuffer_ooowrite_t rb(16 * frames, channels, 4 * frames);
+  std::vector<float> audio(channels * frames, 0.25f);
+  uint64_t sample_index(0);
+  for(auto _ : state) {
+    rb.write_data(audio.data(), frames, channels, sample_index + frames);
+    rb.write_data(audio.data(), frames, channels, sample_index);
+    rb.read_data(audio.data(), frames, channels);
+    rb.read_data(audio.data(), frames, channels);
+    sample_index += 2 * frames;
+  }
+  state.SetItemsProcessed(state.iterations() * 2 * channels * frames);
+}
+BENCHMARK(BM_ringbuffer_reordered)->ArgsProduct({{2, 8}, {64}});
+
+// Local Variables:
+// compile-command: "make -C .. benchmarks"
+// coding: utf-8-unix
+// c-basic-offset: 2
+// indent-tabs-mode: nil
+// End:
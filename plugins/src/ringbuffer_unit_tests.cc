@@ -0,0 +1,141 @@
+#include <gtest/gtest.h>
+
+#include "netaudio.h"
+#include "ringbuffer.h"
+#include <vector>
+
+TEST(ringbuffer, read_before_write)
+{
+  ringbuffer_ooowrite_t rb(64, 2);
+  float audio[16];
+  for(size_t k = 0; k < 16; ++k)
+    audio[k] = 1.0f;
+  EXPECT_EQ(0u, rb.read_data(audio, 8, 2));
+  for(size_t k = 0; k < 16; ++k)
+    EXPECT_EQ(0.0f, audio[k]);
+  EXPECT_EQ(0u, rb.get_missing_frames());
+}
+
+TEST(ringbuffer, write_read)
+{
+  ringbuffer_ooowrite_t rb(64, 2, 4);
+  float audio[16];
+  for(size_t k = 0; k < 16; ++k)
+    audio[k] = k + 1;
+  rb.write_data(audio, 8, 2, 1000);
+  EXPECT_EQ(996u, rb.get_read_pos());
+  EXPECT_EQ(1008u, rb.get_write_pos());
+  EXPECT_EQ(12u, rb.rspace());
+  EXPECT_EQ(52u, rb.wspace());
+  float out[24];
+  EXPECT_EQ(12u, rb.read_data(out, 12, 2));
+  // playout delay is filled with zeros:
+  for(size_t k = 0; k < 8; ++k)
+    EXPECT_EQ(0.0f, out[k]);
+  for(size_t k = 0; k < 16; ++k)
+    EXPECT_EQ(audio[k], out[k + 8]);
+  EXPECT_EQ(0u, rb.rspace());
+  // underrun:
+  EXPECT_EQ(0u, rb.read_data(out, 4, 2));
+  EXPECT_EQ(4u, rb.get_missing_frames());
+  // late chunk:
+  rb.write_data(audio, 8, 2, 1008);
+  EXPECT_EQ(4u, rb.get_late_frames());
+  EXPECT_EQ(4u, rb.rspace());
+}
+
+TEST(ringbuffer, channel_mismatch)
+{
+  ringbuffer_ooowrite_t rb(64, 2);
+  float audio[3] = {1.0f, 2.0f, 3.0f};
+  rb.write_data(audio, 1, 3, 0);
+  float out[3];
+  EXPECT_EQ(1u, rb.read_data(out, 1, 3));
+  EXPECT_EQ(1.0f, out[0]);
+  EXPECT_EQ(2.0f, out[1]);
+  EXPECT_EQ(0.0f, out[2]);
+}
+
+TEST(ringbuffer, resync)
+{
+  ringbuffer_ooowrite_t rb(64, 1);
+  float audio[8];
+  for(size_t k = 0; k < 8; ++k)
+    audio[k] = 1.0f;
+  rb.write_data(audio, 8, 1, 0);
+  float out[8];
+  rb.read_data(out, 8, 1);
+  // sender restarted with a new random index:
+  for(uint64_t n = 0; n < 4; ++n)
+    rb.write_data(audio, 8, 1, 123456789u + 8u * n);
+  rb.read_data(out, 8, 1);
+  EXPECT_EQ(123456789u + 32u, rb.get_read_pos());
+  for(size_t k = 0; k < 8; ++k)
+    EXPECT_EQ(1.0f, out[k]);
+}
+
+// Encode a ramp across the 32-bit wrap point of the sample index,
+// deliver chunks reordered, and check that the jitter buffer returns
+// the continuous ramp.
+TEST(ringbuffer, wraparound_reordered)
+{
+  const size_t fragsize(16);
+  const size_t channels(2);
+  const size_t nchunks(32);
+  netaudio_info_t info(new_netaudio_info(48000, pcmfloat, channels, fragsize));
+  ringbuffer_ooowrite_t rb(4 * fragsize, channels, 2 * fragsize);
+  uint32_t first_index(0u - 10u * (uint32_t)fragsize - 3u);
+  uint64_t timeline((uint64_t)1u << 32);
+  bool has_timeline(false);
+  float audio[fragsize * channels];
+  float out[fragsize * channels];
+  char buffer[1024];
+  std::vector<float> received;
+  for(size_t n = 0; n < nchunks; n += 2) {
+    // send chunks n+1 and n in swapped order:
+    for(size_t m = 0; m < 2; ++m) {
+      size_t chunk(n + 1 - m);
+      for(size_t k = 0; k < fragsize; ++k)
+        for(size_t c = 0; c < channels; ++c)
+          audio[c + channels * k] = (chunk * fragsize + k) * (c ? -1.0f : 1.0f);
+      netaudio_err_t err(netaudio_invalid_checksum);
+      size_t len(encode_audio(info, audio, fragsize * channels,
+                              first_index + chunk * fragsize, buffer, 1024,
+                              err));
+      ASSERT_EQ(netaudio_success, err);
+      uint32_t sample_index(0);
+      decode_audio(info, audio, fragsize * channels, sample_index, buffer, len,
+                   err);
+      ASSERT_EQ(netaudio_success, err);
+      if(!has_timeline) {
+        timeline += sample_index;
+        has_timeline = true;
+      }
+      timeline = unwrap_sample_index(sample_index, timeline);
+      rb.write_data(audio, fragsize, channels, timeline);
+    }
+    for(size_t m = 0; m < 2; ++m) {
+      rb.read_data(out, fragsize, channels);
+      for(size_t k = 0; k < fragsize; ++k) {
+        EXPECT_EQ(out[channels * k], -out[channels * k + 1]);
+        received.push_back(out[channels * k]);
+      }
+    }
+  }
+  EXPECT_EQ(0u, rb.get_late_frames());
+  // the playout delay is relative to the first received chunk, which
+  // is the second chunk of the ramp. It is silent, then the ramp
+  // follows without gaps:
+  size_t delay(2 * fragsize - fragsize);
+  for(size_t k = 0; k < delay; ++k)
+    EXPECT_EQ(0.0f, received[k]);
+  for(size_t k = delay; k < received.size(); ++k)
+    ASSERT_EQ((float)(k - delay), received[k]) << k;
+}
+
+// Local Variables:
+// compile-command: "make -C .. unit-tests"
+// coding: utf-8-unix
+// c-basic-offset: 2
+// indent-tabs-mode: nil
+// End:
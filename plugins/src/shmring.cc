@@ -0,0 +1,249 @@
+#include "shmring.h"
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <stdexcept>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#define SHMRING_MAGIC 0x4e41534du
+#define SHMRING_VERSION 1u
+// length marker of the unused space at the end of the ring:
+#define SHMRING_WRAP 0xffffffffu
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+              "64-bit atomics are not lock-free");
+static_assert(std::atomic<uint32_t>::is_always_lock_free,
+              "32-bit atomics are not lock-free");
+
+struct shmring_t::header_t {
+  std::atomic<uint32_t> magic;
+  uint32_t version;
+  uint64_t capacity;
+  // written by the sender:
+  alignas(64) std::atomic<uint64_t> head;
+  std::atomic<uint32_t> seq;
+  // written by the receiver:
+  alignas(64) std::atomic<uint64_t> tail;
+  std::atomic<uint32_t> waiting;
+};
+
+static size_t align8(size_t n)
+{
+  return (n + 7u) & ~(size_t)7u;
+}
+
+static std::string shm_name(const std::string& name)
+{
+  return "/" + name;
+}
+
+shmring_t::shmring_t(const std::string& name, size_t capacity_)
+{
+  size_t hdrlen(align8(sizeof(header_t)));
+  bool created(true);
+  int fd(shm_open(shm_name(name).c_str(), O_RDWR | O_CREAT | O_EXCL, 0600));
+  if((fd < 0) && (errno == EEXIST)) {
+    created = false;
+    fd = shm_open(shm_name(name).c_str(), O_RDWR, 0600);
+  }
+  if(fd < 0)
+    throw std::runtime_error("shmring: Unable to open shared memory \"" +
+                             name + "\": " + strerror(errno));
+  if(created) {
+    maplen = hdrlen + align8(std::max((size_t)64u, capacity_));
+    if(ftruncate(fd, maplen) != 0) {
+      int e(errno);
+      close(fd);
+      shmring_t::unlink(name);
+      throw std::runtime_error("shmring: Unable to allocate shared memory \"" +
+                               name + "\": " + strerror(e));
+    }
+  } else {
+    // the creating process may still be initializing the object:
+    struct stat st;
+    memset(&st, 0, sizeof(st));
+    for(size_t k = 0; k < 1000; ++k) {
+      if((fstat(fd, &st) == 0) && ((size_t)st.st_size > hdrlen))
+        break;
+      usleep(1000);
+    }
+    maplen = st.st_size;
+    if(maplen <= hdrlen) {
+      close(fd);
+      throw std::runtime_error("shmring: Shared memory \"" + name +
+                               "\" is not initialized.");
+    }
+  }
+  void* mem(mmap(NULL, maplen, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0));
+  close(fd);
+  if(mem == MAP_FAILED)
+    throw std::runtime_error("shmring: Unable to map shared memory \"" + name +
+                             "\": " + strerror(errno));
+  hdr = (header_t*)mem;
+  ring = (char*)mem + hdrlen;
+  capacity = maplen - hdrlen;
+  if(created) {
+    hdr->version = SHMRING_VERSION;
+    hdr->capacity = capacity;
+    hdr->head = 0;
+    hdr->seq = 0;
+    hdr->tail = 0;
+    hdr->waiting = 0;
+    hdr->magic.store(SHMRING_MAGIC, std::memory_order_release);
+  } else {
+    for(size_t k = 0; k < 1000; ++k) {
+      if(hdr->magic.load(std::memory_order_acquire) == SHMRING_MAGIC)
+        break;
+      usleep(1000);
+    }
+    if((hdr->magic.load(std::memory_order_acquire) != SHMRING_MAGIC) ||
+       (hdr->version != SHMRING_VERSION) || (hdr->capacity != capacity)) {
+      munmap(mem, maplen);
+      throw std::runtime_error("shmring: Shared memory \"" + name +
+                               "\" is not a packet ring.");
+    }
+  }
+}
+
+shmring_t::~shmring_t()
+{
+  munmap(hdr, maplen);
+}
+
+void shmring_t::unlink(const std::string& name)
+{
+  shm_unlink(shm_name(name).c_str());
+}
+
+char* shmring_t::borrow(size_t len)
+{
+  size_t need(align8(sizeof(uint32_t) + len));
+  uint64_t head(hdr->head.load(std::memory_order_relaxed));
+  uint64_t tail(hdr->tail.load(std::memory_order_acquire));
+  size_t pos(head % capacity);
+  size_t contiguous(capacity - pos);
+  size_t skip((need > contiguous) ? contiguous : 0u);
+  if((len >= SHMRING_WRAP) || (head + skip + need - tail > capacity)) {
+    ++dropped;
+    return NULL;
+  }
+  if(skip) {
+    // mark remaining space as unused, it is published by commit():
+    uint32_t wrap(SHMRING_WRAP);
+    memcpy(&(ring[pos]), &wrap, sizeof(wrap));
+  }
+  borrowed_pos = head + skip;
+  return &(ring[borrowed_pos % capacity + sizeof(uint32_t)]);
+}
+
+void shmring_t::commit(size_t len)
+{
+  uint32_t len32(len);
+  memcpy(&(ring[borrowed_pos % capacity]), &len32, sizeof(len32));
+  hdr->head.store(borrowed_pos + align8(sizeof(uint32_t) + len),
+                  std::memory_order_release);
+  hdr->seq.fetch_add(1u);
+  if(hdr->waiting.load())
+    syscall(SYS_futex, &(hdr->seq), FUTEX_WAKE, 1, NULL, NULL, 0);
+}
+
+bool shmring_t::send(const char* data, size_t len)
+{
+  char* buf(borrow(len));
+  if(!buf)
+    return false;
+  memcpy(buf, data, len);
+  commit(len);
+  return true;
+}
+
+const char* shmring_t::peek(size_t& len, uint32_t timeout_usec)
+{
+  struct timespec deadline;
+  clock_gettime(CLOCK_MONOTONIC, &deadline);
+  deadline.tv_nsec += 1000l * (timeout_usec % 1000000u);
+  deadline.tv_sec += timeout_usec / 1000000u + deadline.tv_nsec / 1000000000l;
+  deadline.tv_nsec %= 1000000000l;
+  while(true) {
+    uint64_t tail(hdr->tail.load(std::memory_order_relaxed));
+    uint64_t head(hdr->head.load(std::memory_order_acquire));
+    if(head != tail) {
+      size_t pos(tail % capacity);
+      size_t contiguous(capacity - pos);
+      uint32_t len32(SHMRING_WRAP);
+      if(contiguous >= sizeof(len32))
+        memcpy(&len32, &(ring[pos]), sizeof(len32));
+      if((len32 == SHMRING_WRAP) && (head - tail >= contiguous)) {
+        hdr->tail.store(tail + contiguous, std::memory_order_release);
+        continue;
+      }
+      // the length is written by the other process, a packet must
+      // not exceed the end of the ring nor the committed data:
+      size_t size(align8(sizeof(uint32_t) + (size_t)len32));
+      if((len32 == SHMRING_WRAP) || (size > contiguous) ||
+         (size > head - tail)) {
+        hdr->tail.store(head, std::memory_order_release);
+        ++dropped;
+        return NULL;
+      }
+      len = len32;
+      peeked_size = size;
+      return &(ring[pos + sizeof(uint32_t)]);
+    }
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    struct timespec remaining;
+    remaining.tv_sec = deadline.tv_sec - now.tv_sec;
+    remaining.tv_nsec = deadline.tv_nsec - now.tv_nsec;
+    if(remaining.tv_nsec < 0) {
+      remaining.tv_nsec += 1000000000l;
+      --remaining.tv_sec;
+    }
+    if(remaining.tv_sec < 0)
+      return NULL;
+    // announce waiting before checking again, so that commit() does
+    // not miss the wake-up:
+    uint32_t seq(hdr->seq.load());
+    hdr->waiting.store(1u);
+    if(hdr->head.load() == tail)
+      syscall(SYS_futex, &(hdr->seq), FUTEX_WAIT, seq, &remaining, NULL, 0);
+    hdr->waiting.store(0u);
+  }
+}
+
+void shmring_t::release()
+{
+  hdr->tail.store(hdr->tail.load(std::memory_order_relaxed) + peeked_size,
+                  std::memory_order_release);
+  peeked_size = 0;
+}
+
+ssize_t shmring_t::recv(char* data, size_t len, uint32_t timeout_usec)
+{
+  size_t plen(0);
+  const char* packet(peek(plen, timeout_usec));
+  if(!packet)
+    return 0;
+  ssize_t retv(-1);
+  if(plen <= len) {
+    memcpy(data, packet, plen);
+    retv = plen;
+  }
+  release();
+  return retv;
+}
+
+/*
+ * Local Variables:
+ * mode: c++
+ * c-basic-offset: 2
+ * indent-tabs-mode: nil
+ * compile-command: "make -C .."
+ * End:
+ */
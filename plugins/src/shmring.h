@@ -0,0 +1,109 @@
+/**
+ * @file shmring.h
+ * @brief Packet ring buffer in POSIX shared memory
+ */
+
+#ifndef SHMRING_H
+#define SHMRING_H
+
+#include <atomic>
+#include <stdint.h>
+#include <string>
+#include <sys/types.h>
+
+/**
+ * @brief Lock-free packet queue between two processes on the same host
+ *
+ * One process writes packets, one process reads them
+ * (single-producer single-consumer). The ring lives in a POSIX shared
+ * memory object, which is created by the first instance opening it and
+ * reused by all further instances. The object is not removed when the
+ * instances are destroyed, so that either side can be restarted; use
+ * shmring_t::unlink() to remove it.
+ *
+ * Packets are stored as a 32-bit length followed by the payload,
+ * padded to 8 bytes. A packet never wraps around the end of the
+ * ring.
+ */
+class shmring_t {
+public:
+  /**
+   * @param name Name of shared memory object, without leading slash
+   * @param capacity Size of ring in bytes, used only if the object
+   * does not exist yet
+   */
+  shmring_t(const std::string& name, size_t capacity = 1u << 20);
+  ~shmring_t();
+  /**
+   * Borrow memory for the next packet.
+   *
+   * @param len Maximum packet size in bytes
+   * @return Pointer into the ring, or NULL if the ring is full
+   *
+   * Fill the memory and call commit() to send the packet.
+   */
+  char* borrow(size_t len);
+  /**
+   * Send the packet in the memory obtained by borrow().
+   *
+   * @param len Packet size in bytes, not larger than requested in borrow()
+   */
+  void commit(size_t len);
+  /**
+   * Copy a packet into the ring.
+   *
+   * @return True on success, false if the ring is full
+   */
+  bool send(const char* data, size_t len);
+  /**
+   * Return the next packet without copying it.
+   *
+   * @param[out] len Packet size in bytes
+   * @param timeout_usec Maximum time to wait for a packet
+   * @return Pointer to packet, or NULL if no packet was received
+   *
+   * The packet remains valid until release() is called.
+   */
+  const char* peek(size_t& len, uint32_t timeout_usec);
+  /**
+   * Remove the packet returned by peek() from the ring.
+   */
+  void release();
+  /**
+   * Copy the next packet into a buffer.
+   *
+   * @return Packet size, zero on timeout, or -1 if the packet was
+   * larger than the buffer (in which case the packet is dropped)
+   */
+  ssize_t recv(char* data, size_t len, uint32_t timeout_usec);
+  /// Size of ring in bytes
+  size_t get_capacity() const { return capacity; };
+  /// Number of packets dropped by send() or borrow() because the ring was
+  /// full, and by peek() because of an invalid packet length
+  size_t get_dropped() const { return dropped; };
+  /**
+   * Remove a shared memory object.
+   */
+  static void unlink(const std::string& name);
+
+private:
+  struct header_t;
+  header_t* hdr = NULL;
+  char* ring = NULL;
+  size_t capacity = 0;
+  size_t maplen = 0;
+  uint64_t borrowed_pos = 0;
+  size_t peeked_size = 0;
+  size_t dropped = 0;
+};
+
+#endif
+
+/*
+ * Local Variables:
+ * mode: c++
+ * c-basic-offset: 2
+ * indent-tabs-mode: nil
+ * compile-command: "make -C .."
+ * End:
+ */
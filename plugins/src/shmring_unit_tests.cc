@@ -0,0 +1,138 @@
+#include <gtest/gtest.h>
+
+#include "shmring.h"
+#include <string.h>
+#include <thread>
+#include <unistd.h>
+
+static std::string test_name(const char* name)
+{
+  return std::string("shmring_test_") + name + "_" + std::to_string(getpid());
+}
+
+TEST(shmring, send_recv)
+{
+  std::string name(test_name("send_recv"));
+  shmring_t::unlink(name);
+  shmring_t sender(name, 256);
+  shmring_t receiver(name);
+  EXPECT_EQ(256u, receiver.get_capacity());
+  char buf[64];
+  EXPECT_EQ(0, receiver.recv(buf, 64, 0));
+  EXPECT_TRUE(sender.send("hello", 5));
+  EXPECT_TRUE(sender.send("world!", 6));
+  EXPECT_EQ(5, receiver.recv(buf, 64, 0));
+  EXPECT_EQ(0, memcmp(buf, "hello", 5));
+  EXPECT_EQ(6, receiver.recv(buf, 64, 0));
+  EXPECT_EQ(0, memcmp(buf, "world!", 6));
+  EXPECT_EQ(0, receiver.recv(buf, 64, 1000));
+  // packet larger than receive buffer is dropped:
+  EXPECT_TRUE(sender.send("0123456789", 10));
+  EXPECT_EQ(-1, receiver.recv(buf, 4, 0));
+  EXPECT_EQ(0, receiver.recv(buf, 64, 0));
+  shmring_t::unlink(name);
+}
+
+TEST(shmring, wraparound)
+{
+  std::string name(test_name("wraparound"));
+  shmring_t::unlink(name);
+  shmring_t sender(name, 256);
+  shmring_t receiver(name);
+  char data[100];
+  char buf[128];
+  for(size_t n = 0; n < 50; ++n) {
+    size_t len(1 + (n * 37) % 100);
+    for(size_t k = 0; k < len; ++k)
+      data[k] = n + k;
+    char* dest(sender.borrow(len));
+    ASSERT_TRUE(dest != NULL);
+    memcpy(dest, data, len);
+    sender.commit(len);
+    size_t plen(0);
+    const char* packet(receiver.peek(plen, 0));
+    ASSERT_TRUE(packet != NULL);
+    ASSERT_EQ(len, plen);
+    EXPECT_EQ(0, memcmp(packet, data, len));
+    receiver.release();
+  }
+  EXPECT_EQ(0, receiver.recv(buf, 128, 0));
+  EXPECT_EQ(0u, sender.get_dropped());
+  shmring_t::unlink(name);
+}
+
+TEST(shmring, full)
+{
+  std::string name(test_name("full"));
+  shmring_t::unlink(name);
+  shmring_t sender(name, 256);
+  shmring_t receiver(name);
+  char data[60];
+  memset(data, 1, 60);
+  // each packet uses 64 bytes:
+  for(size_t n = 0; n < 4; ++n)
+    EXPECT_TRUE(sender.send(data, 60));
+  EXPECT_FALSE(sender.send(data, 1));
+  EXPECT_EQ(1u, sender.get_dropped());
+  EXPECT_TRUE(sender.borrow(1000) == NULL);
+  char buf[64];
+  EXPECT_EQ(60, receiver.recv(buf, 64, 0));
+  EXPECT_TRUE(sender.send(data, 60));
+  shmring_t::unlink(name);
+}
+
+TEST(shmring, invalid_length)
+{
+  std::string name(test_name("invalid_length"));
+  shmring_t::unlink(name);
+  shmring_t sender(name, 256);
+  shmring_t receiver(name);
+  char buf[64];
+  // corrupt the length of committed packets, as a faulty or hostile
+  // sender could:
+  for(uint32_t len32 : {250u, 20u, 0xfffffffeu}) {
+    char* dest(sender.borrow(8));
+    ASSERT_TRUE(dest != NULL);
+    sender.commit(8);
+    memcpy(dest - sizeof(len32), &len32, sizeof(len32));
+    size_t plen(0);
+    EXPECT_TRUE(receiver.peek(plen, 0) == NULL) << len32;
+    // the receiver resynchronizes to the sender:
+    EXPECT_TRUE(sender.send("abc", 3));
+    EXPECT_EQ(3, receiver.recv(buf, 64, 0));
+    EXPECT_EQ(0, memcmp(buf, "abc", 3));
+  }
+  EXPECT_EQ(3u, receiver.get_dropped());
+  shmring_t::unlink(name);
+}
+
+TEST(shmring, wakeup)
+{
+  std::string name(test_name("wakeup"));
+  shmring_t::unlink(name);
+  shmring_t receiver(name, 4096);
+  shmring_t sender(name);
+  std::thread thread([&sender]() {
+    for(uint32_t n = 0; n < 100; ++n) {
+      while(!sender.send((const char*)&n, sizeof(n)))
+        usleep(100);
+      if(n % 10 == 0)
+        usleep(1000);
+    }
+  });
+  for(uint32_t n = 0; n < 100; ++n) {
+    uint32_t v(0);
+    ASSERT_EQ((ssize_t)sizeof(v),
+              receiver.recv((char*)&v, sizeof(v), 1000000u));
+    EXPECT_EQ(n, v);
+  }
+  thread.join();
+  shmring_t::unlink(name);
+}
+
+// Local Variables:
+// compile-command: "make -C .. unit-tests"
+// coding: utf-8-unix
+// c-basic-offset: 2
+// indent-tabs-mode: nil
+// End:
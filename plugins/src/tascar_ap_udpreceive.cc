@@ -1,51 +1,14 @@
+#include "capture.h"
+#include "cipher.h"
+#include "jittercontroller.h"
 #include "netaudio.h"
+#include "receiver.h"
+#include "recorder.h"
+#include "resampler.h"
+#include "ringbuffer.h"
+#include "transport.h"
 #include <tascar/audioplugin.h>
 #include <thread>
-#include <udpsocket.h>
-
-class ringbuffer_ooowrite_t {
-public:
-  ringbuffer_ooowrite_t(size_t frames, size_t channels);
-  ~ringbuffer_ooowrite_t();
-  void write_data(float* audio, size_t wframes, size_t wchannels,
-                  size_t sample_index);
-  inline size_t rspace() const
-  {
-    if(wpos > rpos)
-      return wpos - rpos - 1;
-    return frames + wpos - rpos - 1;
-  };
-  inline size_t wspace() const
-  {
-    if(rpos > wpos)
-      return rpos - wpos - 1;
-    return frames + rpos - wpos - 1;
-  };
-
-private:
-  size_t frames = 1;
-  size_t channels = 1;
-  float* data = NULL;
-  size_t wpos = 1;
-  size_t rpos = 0;
-};
-
-ringbuffer_ooowrite_t::ringbuffer_ooowrite_t(size_t frames, size_t channels)
-    : frames(frames), channels(channels)
-{
-  data = new float[std::max((size_t)1u, frames * channels)];
-}
-
-ringbuffer_ooowrite_t::~ringbuffer_ooowrite_t()
-{
-  delete[] data;
-}
-
-void ringbuffer_ooowrite_t::write_data(float* audio, size_t wframes,
-                                       size_t wchannels, size_t sample_index)
-{
-  sample_index = sample_index % frames;
-}
 
 /*
   This example implements an audio plugin which is a white noise
@@ -62,21 +25,45 @@ public:
   virtual ~udpreceive_t();
   void configure();
   void release();
+  void add_variables(TASCAR::osc_server_t* srv);
 
 private:
   void recsrv();
   std::thread recthread;
   std::atomic_bool runsession = true;
-  udpsocket_t socket;
+  netaudio_transport_t* transport = NULL;
+  std::string host;
   int32_t port = 0;
-  netaudio_info_t info;
-  char* cbuffer = NULL;
-  size_t cbufferlen = 0;
-  size_t cyclecounter = 0;
-  netaudio_err_t errcode;
+  double buffer = 10.0;
   float* audiobuffer = NULL;
-  uint32_t sample_index = 0;
-  uint32_t prev_sampleidx = 0;
+  ringbuffer_ooowrite_t* jitterbuffer = NULL;
+  netaudio_receiver_t* receiver = NULL;
+  std::string capturefile;
+  capture_writer_t* capture = NULL;
+  std::string recordfile;
+  std::string recordformat = "float";
+  recorder_t* recorder = NULL;
+  double reportperiod = 200.0;
+  // encryption and authentication:
+  std::string key;
+  std::string cipher = "chacha20-poly1305";
+  packet_cipher_t* sealer = NULL;
+  // adaptive playout delay:
+  bool adaptive = false;
+  double minbuffer = 2.0;
+  double maxbuffer = 100.0;
+  double maxloss = 0.01;
+  double maxstretch = 0.005;
+  jitter_controller_t* controller = NULL;
+  resampler_t* resampler = NULL;
+  // parallel decoding:
+  uint32_t threads = 1;
+  // telemetry:
+  float targetbuffer = 0.0f;
+  float currentbuffer = 0.0f;
+  float jitter = 0.0f;
+  float laterate = 0.0f;
+  float stretch = 1.0f;
 };
 
 // default constructor, called while loading the plugin
@@ -84,108 +71,195 @@ udpreceive_t::udpreceive_t(const TASCAR::audioplugin_cfg_t& cfg)
     : audioplugin_base_t(cfg)
 {
   // register variable for XML access:
+  GET_ATTRIBUTE(host, "",
+                "\"shm:name\" for shared memory transport from a sender on the "
+                "same host, \"file:path\" to replay a capture file, "
+                "\"loopback:name\" for a sender in the same process, or empty "
+                "for UDP");
   GET_ATTRIBUTE(port, "", "destination port number");
-  socket.set_timeout_usec(10000);
-  socket.bind(port, true);
+  GET_ATTRIBUTE(buffer, "ms", "jitter buffer playout delay");
+  GET_ATTRIBUTE(capturefile, "",
+                "name of capture file to store all received packets with "
+                "arrival times, or empty for no capture");
+  GET_ATTRIBUTE(recordfile, "",
+                "name of sound file to record the received audio, with "
+                "extension \".wav\", \".rf64\" or \".caf\", or empty for no "
+                "recording");
+  GET_ATTRIBUTE(recordformat, "",
+                "sample format of recording: \"pcm16\" for 16 bit integer or "
+                "\"float\" for 32 bit float");
+  GET_ATTRIBUTE(reportperiod, "ms",
+                "period of receiver reports sent back to the sender, or zero "
+                "to send no reports");
+  GET_ATTRIBUTE(key, "",
+                "pre-shared key of 64 hexadecimal digits of encrypted and "
+                "authenticated streams, or empty for unencrypted streams");
+  GET_ATTRIBUTE(cipher, "",
+                "encryption algorithm: \"chacha20-poly1305\" or "
+                "\"aes-256-gcm\"");
+  GET_ATTRIBUTE_BOOL(adaptive, "adapt playout delay to network jitter, "
+                               "starting with buffer");
+  GET_ATTRIBUTE(minbuffer, "ms", "minimum playout delay in adaptive mode");
+  GET_ATTRIBUTE(maxbuffer, "ms", "maximum playout delay in adaptive mode");
+  GET_ATTRIBUTE(maxloss, "",
+                "tolerated rate of late packets in adaptive mode, lower "
+                "values increase the latency");
+  GET_ATTRIBUTE(maxstretch, "",
+                "maximum relative change of playback speed to adapt the "
+                "playout delay");
+  GET_ATTRIBUTE(threads, "",
+                "number of threads to decode groups of 16 channels in "
+                "parallel, including the receiver thread");
+  if((recordformat != "pcm16") && (recordformat != "float"))
+    throw TASCAR::ErrMsg("Invalid sample format \"" + recordformat +
+                         "\" (valid formats: pcm16, float).");
+  cipher_alg_t alg;
+  if(!get_cipher_alg(cipher, alg))
+    throw TASCAR::ErrMsg("Invalid cipher \"" + cipher +
+                         "\" (valid ciphers: chacha20-poly1305, "
+                         "aes-256-gcm).");
+  if(!key.empty())
+    sealer = new packet_cipher_t(key, cipher_receiver, alg);
+  transport = create_transport(host, port, true);
 }
 
 void udpreceive_t::configure()
 {
   TASCAR::audioplugin_base_t::configure();
-  info = new_netaudio_info(f_sample, pcm16bit, n_channels, n_fragment);
-  cbufferlen = std::max(get_buffer_length_header(), get_buffer_length(info));
-  cbuffer = new char[cbufferlen];
-  cyclecounter = 0;
   audiobuffer = new float[n_channels * n_fragment];
+  size_t delay(std::max(0.0, 0.001 * buffer * f_sample));
+  size_t maxdelay(delay);
+  if(adaptive)
+    maxdelay = std::max(0.0, 0.001 * std::max(buffer, maxbuffer) * f_sample);
+  jitterbuffer = new ringbuffer_ooowrite_t(4u * (maxdelay + n_fragment),
+                                           n_channels, delay);
+  receiver = new netaudio_receiver_t(*jitterbuffer);
+  receiver->set_threads(threads);
+  if(adaptive) {
+    controller = new jitter_controller_t(f_sample, 0.001 * buffer,
+                                         0.001 * minbuffer, 0.001 * maxbuffer,
+                                         maxloss, maxstretch);
+    resampler = new resampler_t(n_channels, n_fragment, maxstretch);
+    receiver->set_controller(controller);
+  }
+  if(!capturefile.empty())
+    capture = new capture_writer_t(capturefile);
+  if(!recordfile.empty())
+    // FIFO of one second, to bridge slow file system operations:
+    recorder = new recorder_t(recordfile, f_sample, n_channels, n_fragment,
+                              std::max(4.0, f_sample / n_fragment),
+                              (recordformat == "float") ? pcmfloat : pcm16bit);
   runsession = true;
   recthread = std::thread(&udpreceive_t::recsrv, this);
 }
 
 void udpreceive_t::recsrv()
 {
-  char buffer[BUFSIZE];
-  float* audio = NULL;
-  size_t audio_numelem = 0;
-  endpoint_t sender_endpoint;
-  netaudio_info_t info;
-  bool has_info = false;
-  uint32_t sample_index = 0;
-  double c = 0.999;
-  double w_samplecnt = 1.0;
-  double w_duration = 1.0;
-  float nominalsrate = -1;
-  TASCAR::tictoc_t tictoc;
-  // tictoc.tic();
+  std::vector<char> report_packet(get_buffer_length_report() +
+                                  packet_cipher_t::overhead);
+  std::vector<char> opened(sealer ? NETAUDIO_MAX_PACKET_SIZE : 0u);
+  uint64_t report_interval(1e6 * std::max(0.0, reportperiod));
+  uint64_t next_report(get_time_ns() + report_interval);
   while(runsession) {
-    ssize_t n = socket.recvfrom(buffer, BUFSIZE, sender_endpoint);
-    if(n > 0) {
-      netaudio_err_t err;
-      size_t recbytes = decode_header(info, buffer, n, err);
-      if(err == netaudio_success) {
-        DEBUG(info.id);
-        DEBUG(info.samplefmt);
-        DEBUG(info.srate);
-        DEBUG(info.channels);
-        DEBUG(info.fragsize);
-        if(info.srate != nominalsrate) {
-          nominalsrate = info.srate;
-          w_samplecnt = nominalsrate;
-          w_duration = 1.0;
-        }
-        if(audio_numelem != info.channels * info.fragsize) {
-          audio_numelem = info.channels * info.fragsize;
-          if(audio)
-            delete[] audio;
-          audio = new float[audio_numelem];
-        }
-        has_info = true;
-      } else {
-        if(has_info) {
-          recbytes = decode_audio(info, audio, audio_numelem, sample_index,
-                                  buffer, n, err);
-          if(err == netaudio_success) {
-            uint32_t samples = sample_index - prev_sampleidx;
-            prev_sampleidx = sample_index;
-            if((samples > 0) && (samples < 1 << 30)) {
-              // DEBUG(samples);
-              double dt = tictoc.tictoc();
-              // c = 1.0/(1.0+dt);
-              w_samplecnt *= c;
-              //w_samplecnt += (1.0 - c) * samples;
-              w_samplecnt += samples;
-              w_duration *= c;
-              //w_duration += (1.0 - c) * dt;
-              w_duration += dt;
-              std::cout << w_samplecnt << "  " << w_duration << "   "
-                        << w_samplecnt / w_duration << std::endl;
-              // DEBUG(w_samplecnt/w_duration);
-              // DEBUG(dt);
-            }
-          }
-        }
+    size_t n(0);
+    const char* buffer(transport->receive(n, 10000));
+    uint64_t now(get_time_ns());
+    const char* packet(buffer);
+    if(buffer && (n > 0) && sealer) {
+      // unauthentic packets and replays are dropped:
+      n = sealer->open(buffer, n, opened.data(), opened.size(), now);
+      packet = opened.data();
+    }
+    if(buffer && (n > 0)) {
+      // opened packets are captured, to analyze them without the key:
+      if(capture)
+        capture->write(packet, n, now);
+      receiver->process_packet(packet, n, now);
+    }
+    if(buffer)
+      transport->release();
+    if(report_interval && (now >= next_report)) {
+      next_report += report_interval;
+      if(next_report < now)
+        next_report = now + report_interval;
+      netaudio_report_t report;
+      if(receiver->get_report(report)) {
+        netaudio_err_t err;
+        size_t offset(sealer ? netaudio_sealed_data : 0u);
+        size_t len(encode_report(report, &(report_packet[offset]),
+                                 report_packet.size() - offset, err));
+        if(sealer && len)
+          len = sealer->seal(report_packet.data(), report_packet.size(), len);
+        if(len)
+          transport->reply(report_packet.data(), len);
       }
     }
   }
-  if(audio)
-    delete[] audio;
 }
 
 void udpreceive_t::release()
 {
   runsession = false;
   recthread.join();
-  delete[] cbuffer;
   delete[] audiobuffer;
+  delete capture;
+  capture = NULL;
+  delete recorder;
+  recorder = NULL;
+  delete receiver;
+  receiver = NULL;
+  delete resampler;
+  resampler = NULL;
+  delete controller;
+  controller = NULL;
+  delete jitterbuffer;
+  jitterbuffer = NULL;
   TASCAR::audioplugin_base_t::release();
 }
 
-udpreceive_t::~udpreceive_t() {}
+udpreceive_t::~udpreceive_t()
+{
+  delete transport;
+  delete sealer;
+}
+
+void udpreceive_t::add_variables(TASCAR::osc_server_t* srv)
+{
+  // telemetry of adaptive playout delay, updated in every cycle:
+  srv->add_float("/targetbuffer", &targetbuffer);
+  srv->add_float("/currentbuffer", &currentbuffer);
+  srv->add_float("/jitter", &jitter);
+  srv->add_float("/laterate", &laterate);
+  srv->add_float("/stretch", &stretch);
+}
 
 void udpreceive_t::ap_process(std::vector<TASCAR::wave_t>& chunk,
                               const TASCAR::pos_t& pos,
                               const TASCAR::zyx_euler_t& o,
                               const TASCAR::transport_t& tp)
 {
+  // the received audio is written directly into a block of the
+  // recorder, if one is available:
+  float* buf(audiobuffer);
+  float* recbuf(recorder ? recorder->borrow() : NULL);
+  if(recbuf)
+    buf = recbuf;
+  if(controller) {
+    resampler->read(*jitterbuffer, buf, n_fragment,
+                    controller->get_ratio());
+    targetbuffer = 1000.0 * controller->get_target();
+    currentbuffer = 1000.0 * controller->get_delay();
+    jitter = 1000.0 * controller->get_jitter();
+    laterate = controller->get_late_rate();
+    stretch = controller->get_ratio();
+  } else {
+    jitterbuffer->read_data(buf, n_fragment, n_channels);
+  }
+  for(size_t k = 0; k < n_fragment; ++k)
+    for(size_t c = 0; c < n_channels; ++c)
+      chunk[c][k] = buf[c + n_channels * k];
+  if(recbuf)
+    recorder->commit();
 }
 
 // create the plugin interface:
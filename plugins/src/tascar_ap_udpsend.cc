@@ -1,6 +1,11 @@
+#include "cipher.h"
+#include "dither.h"
+#include "driftcomp.h"
+#include "linkadapt.h"
 #include "netaudio.h"
+#include "transport.h"
 #include <tascar/audioplugin.h>
-#include <udpsocket.h>
+#include <thread>
 
 /*
   This example implements an audio plugin which is a white noise
@@ -19,11 +24,39 @@ public:
   void release();
 
 private:
-  udpsocket_t socket;
+  void set_config(const link_config_t& cfg);
+  void send_packet(float* audio);
+  void commit_packet(char* cbuffer, size_t codedbytes);
+  void reportsrv();
+  netaudio_transport_t* transport;
   std::string host;
   int32_t port;
+  int32_t protocol;
+  bool sparse;
+  std::string dither;
+  dither_t* requantizer;
+  std::string format;
+  // adaptation to receiver reports:
+  bool adaptive;
+  double maxloss;
+  uint32_t mtu;
+  link_adapter_t* adapter;
+  std::thread reportthread;
+  std::atomic_bool runreports;
+  std::atomic<uint32_t> chksum;
+  // resampling to the receiver clock:
+  bool driftcomp;
+  double drift;
+  double maxdrift;
+  drift_compensator_t* compensator;
+  float* packetbuffer;
+  // encryption and authentication:
+  std::string key;
+  std::string cipher;
+  packet_cipher_t* sealer;
+  size_t payload;
   netaudio_info_t info;
-  char* cbuffer;
+  netaudio_codec_t codec;
   size_t cbufferlen;
   size_t cyclecounter;
   netaudio_err_t errcode;
@@ -33,54 +66,238 @@ private:
 
 // default constructor, called while loading the plugin
 udpsend_t::udpsend_t(const TASCAR::audioplugin_cfg_t& cfg)
-    : audioplugin_base_t(cfg), host("localhost"), port(0), cbuffer(NULL),
-      cbufferlen(0), cyclecounter(0), audiobuffer(NULL), sample_index(random())
+    : audioplugin_base_t(cfg), transport(NULL), host("localhost"), port(0),
+      protocol(1), sparse(false), dither("none"),
+      requantizer(NULL), format("pcm16"), adaptive(false), maxloss(0.02),
+      mtu(1472), adapter(NULL), runreports(false), chksum(0),
+      driftcomp(false), drift(0.0), maxdrift(1000.0), compensator(NULL),
+      packetbuffer(NULL), cipher("chacha20-poly1305"), sealer(NULL),
+      payload(0), cbufferlen(0), cyclecounter(0), audiobuffer(NULL),
+      sample_index(random())
 {
   // register variable for XML access:
-  GET_ATTRIBUTE(host, "", "destination host");
+  GET_ATTRIBUTE(host, "",
+                "destination host, \"shm:name\" for shared memory transport "
+                "to a receiver on the same host, \"file:path\" to capture "
+                "packets to a file, or \"loopback:name\" for a receiver in "
+                "the same process");
   GET_ATTRIBUTE(port, "", "destination port number");
-  socket.set_destination(host.c_str());
+  GET_ATTRIBUTE(protocol, "",
+                "protocol version: 1, which is understood by all receivers, "
+                "or 2, which requires receivers of version 2 or later");
+  GET_ATTRIBUTE_BOOL(sparse, "omit silent channels from audio chunks");
+  GET_ATTRIBUTE(dither, "",
+                "dither of 16 bit samples: \"none\", \"tpdf\" or "
+                "\"shaped\" for noise shaped TPDF dither");
+  GET_ATTRIBUTE(format, "",
+                "sample format: \"pcm16\" for 16 bit integer or \"float\" "
+                "for 32 bit floating point");
+  GET_ATTRIBUTE_BOOL(adaptive,
+                     "adapt sample format and packet size to the loss rate "
+                     "in receiver reports");
+  GET_ATTRIBUTE(maxloss, "",
+                "tolerated loss rate in adaptive mode, higher loss rates "
+                "reduce the sample format and packet size");
+  GET_ATTRIBUTE(mtu, "bytes",
+                "largest packet size which is not fragmented, used in "
+                "adaptive mode");
+  GET_ATTRIBUTE_BOOL(driftcomp,
+                     "resample to the clock of the receiver, following the "
+                     "clock drift in receiver reports");
+  GET_ATTRIBUTE(drift, "ppm",
+                "known drift of the sender clock relative to the receiver "
+                "clock, e.g., measured against a reference clock; resample "
+                "to the receiver clock if not zero");
+  GET_ATTRIBUTE(maxdrift, "ppm", "maximum compensated clock drift");
+  GET_ATTRIBUTE(key, "",
+                "pre-shared key of 64 hexadecimal digits to encrypt and "
+                "authenticate all packets, or empty for no encryption");
+  GET_ATTRIBUTE(cipher, "",
+                "encryption algorithm: \"chacha20-poly1305\" or "
+                "\"aes-256-gcm\", which is faster on CPUs with AES "
+                "instructions");
+  dither_mode_t mode;
+  if(!get_dither_mode(dither, mode))
+    throw TASCAR::ErrMsg("Invalid dither mode \"" + dither +
+                         "\" (valid modes: none, tpdf, shaped).");
+  if((format != "pcm16") && (format != "float"))
+    throw TASCAR::ErrMsg("Invalid sample format \"" + format +
+                         "\" (valid formats: pcm16, float).");
+  if((protocol != 1) && (protocol != NETAUDIO_PROTOCOL_VERSION))
+    throw TASCAR::ErrMsg("Invalid protocol version " +
+                         std::to_string(protocol) + " (valid versions: 1, " +
+                         std::to_string(NETAUDIO_PROTOCOL_VERSION) + ").");
+  cipher_alg_t alg;
+  if(!get_cipher_alg(cipher, alg))
+    throw TASCAR::ErrMsg("Invalid cipher \"" + cipher +
+                         "\" (valid ciphers: chacha20-poly1305, "
+                         "aes-256-gcm).");
+  if(!key.empty()) {
+    sealer = new packet_cipher_t(key, cipher_sender, alg);
+    // packets are encoded after the clear text fields:
+    payload = netaudio_sealed_data;
+  }
+  transport = create_transport(host, port, false);
 }
 
 void udpsend_t::configure()
 {
   TASCAR::audioplugin_base_t::configure();
-  info = new_netaudio_info(f_sample, pcm16bit, n_channels, n_fragment);
+  link_config_t cfg = {(format == "float") ? pcmfloat : pcm16bit,
+                       (uint32_t)n_fragment};
+  // the preferred configuration has the largest packets:
+  set_config(cfg);
   cbufferlen = std::max(get_buffer_length_header(), get_buffer_length(info));
-  cbuffer = new char[cbufferlen];
+  if(sealer)
+    cbufferlen += packet_cipher_t::overhead;
   cyclecounter = 0;
   audiobuffer = new float[n_channels * n_fragment];
+  dither_mode_t mode(dither_none);
+  get_dither_mode(dither, mode);
+  if(mode != dither_none)
+    requantizer = new dither_t(n_channels, mode, random());
+  if(adaptive) {
+    // the MTU includes the overhead of sealed packets:
+    size_t maxsize(mtu - (sealer ? packet_cipher_t::overhead : 0u));
+    adapter = new link_adapter_t(cfg.samplefmt, n_fragment, n_channels,
+                                 maxloss, maxsize);
+  }
+  if(driftcomp || (drift != 0.0)) {
+    compensator = new drift_compensator_t(n_channels, n_fragment, 1e-6 * drift,
+                                          1e-6 * maxdrift);
+    packetbuffer = new float[n_channels * n_fragment];
+  }
+  if(adaptive || driftcomp) {
+    runreports = true;
+    reportthread = std::thread(&udpsend_t::reportsrv, this);
+  }
 }
 
 void udpsend_t::release()
 {
-  delete[] cbuffer;
+  if(runreports) {
+    runreports = false;
+    reportthread.join();
+  }
+  delete adapter;
+  adapter = NULL;
+  delete compensator;
+  compensator = NULL;
+  delete[] packetbuffer;
+  packetbuffer = NULL;
   delete[] audiobuffer;
+  delete requantizer;
+  requantizer = NULL;
   TASCAR::audioplugin_base_t::release();
 }
 
-udpsend_t::~udpsend_t() {}
+void udpsend_t::set_config(const link_config_t& cfg)
+{
+  info = new_netaudio_info(f_sample, cfg.samplefmt, n_channels, cfg.fragsize,
+                           protocol);
+  codec = new_netaudio_codec(info);
+  chksum = info.chksum;
+}
+
+void udpsend_t::reportsrv()
+{
+  char opened[netaudio_report_size];
+  while(runreports) {
+    size_t len(0);
+    const char* data(transport->receive_reply(len, 100000));
+    if(data && sealer) {
+      // unauthentic reports are ignored:
+      len = sealer->open(data, len, opened, sizeof(opened), get_time_ns());
+      data = len ? opened : NULL;
+    }
+    netaudio_report_t report;
+    netaudio_err_t err;
+    // reports of previous configurations are ignored:
+    if(data && decode_report(report, data, len, err) &&
+       (report.chksum == chksum)) {
+      if(adapter)
+        adapter->update(report, get_time_ns());
+      if(compensator && driftcomp)
+        compensator->update(report);
+    }
+  }
+}
+
+udpsend_t::~udpsend_t()
+{
+  delete transport;
+  delete sealer;
+}
 
 void udpsend_t::ap_process(std::vector<TASCAR::wave_t>& chunk,
                            const TASCAR::pos_t&, const TASCAR::zyx_euler_t&,
                            const TASCAR::transport_t&)
 {
-  // implement the algrithm:
+  // packets are encoded directly into transport buffers. If no
+  // buffer is available, e.g., because a shared memory ring is full,
+  // the packet is lost.
+  if(adapter) {
+    link_config_t cfg(adapter->get_config());
+    if((cfg.samplefmt != info.samplefmt) || (cfg.fragsize != info.fragsize)) {
+      // announce the new configuration immediately:
+      set_config(cfg);
+      cyclecounter = 0;
+    }
+  }
   if(!cyclecounter) {
     cyclecounter = std::max(1.0, f_fragment);
-    size_t codedbytes(encode_header(info, cbuffer, cbufferlen, errcode));
-    socket.send(cbuffer, codedbytes, port);
-    // ignore errors for now.
+    char* cbuffer(transport->borrow(cbufferlen));
+    if(cbuffer)
+      // ignore errors for now.
+      commit_packet(cbuffer, encode_header(info, &(cbuffer[payload]),
+                                           cbufferlen - payload, errcode));
   } else {
     --cyclecounter;
   }
   for(size_t k = 0; k < n_fragment; ++k)
     for(size_t c = 0; c < n_channels; ++c)
       audiobuffer[c + n_channels * k] = chunk[c][k];
-  size_t codedbytes(encode_audio(info, audiobuffer, n_fragment * n_channels,
-                                 sample_index, cbuffer, cbufferlen, errcode));
-  sample_index += n_fragment;
-  socket.send(cbuffer, codedbytes, port);
+  if(compensator) {
+    // the number of packets per block varies with the resampling
+    // ratio:
+    compensator->write(audiobuffer, n_fragment);
+    while(compensator->read(packetbuffer, info.fragsize))
+      send_packet(packetbuffer);
+  } else {
+    // the block is split into packets of info.fragsize frames:
+    for(size_t k = 0; k < n_fragment; k += info.fragsize)
+      send_packet(&(audiobuffer[k * n_channels]));
+  }
+}
+
+void udpsend_t::send_packet(float* audio)
+{
+  if(requantizer && (info.samplefmt == pcm16bit))
+    requantizer->process(audio, info.fragsize);
+  size_t num_elem(info.fragsize * n_channels);
+  char* cbuffer(transport->borrow(cbufferlen));
+  if(cbuffer) {
+    size_t codedbytes;
+    if(sparse)
+      codedbytes = encode_audio_sparse(info, audio, num_elem, sample_index,
+                                       &(cbuffer[payload]),
+                                       cbufferlen - payload, errcode);
+    else
+      codedbytes = encode_audio(codec, audio, num_elem, sample_index,
+                                &(cbuffer[payload]), cbufferlen - payload,
+                                errcode);
+    commit_packet(cbuffer, codedbytes);
+  }
+  sample_index += info.fragsize;
+}
+
+void udpsend_t::commit_packet(char* cbuffer, size_t codedbytes)
+{
+  // packets are sealed in place:
+  if(sealer && codedbytes)
+    codedbytes = sealer->seal(cbuffer, cbufferlen, codedbytes);
+  if(codedbytes)
+    transport->commit(codedbytes);
 }
 
 // create the plugin interface:
@@ -0,0 +1,312 @@
+#include "transport.h"
+#include "capture.h"
+#include "shmring.h"
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// largest UDP payload:
+#define MAX_PACKET_SIZE 65536
+
+uint64_t get_time_ns()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+bool netaudio_transport_t::send(const char* data, size_t len)
+{
+  char* buf(borrow(len));
+  if(!buf)
+    return false;
+  memcpy(buf, data, len);
+  commit(len);
+  return true;
+}
+
+const char* netaudio_transport_t::receive_reply(size_t&, uint32_t timeout_usec)
+{
+  // no return path, behave like a silent network:
+  usleep(timeout_usec);
+  return NULL;
+}
+
+udp_transport_t::udp_transport_t(const std::string& host, int32_t port)
+    : port(port), timeout_usec(10000), recbuf(MAX_PACKET_SIZE)
+{
+  memset(&sender_endpoint, 0, sizeof(sender_endpoint));
+  if(host.empty()) {
+    socket.set_timeout_usec(timeout_usec);
+    has_timeout = true;
+    socket.bind(port, true);
+  } else {
+    socket.set_destination(host.c_str());
+  }
+}
+
+char* udp_transport_t::borrow(size_t len)
+{
+  if(sendbuf.size() < len)
+    sendbuf.resize(len);
+  return sendbuf.data();
+}
+
+void udp_transport_t::commit(size_t len)
+{
+  socket.send(sendbuf.data(), len, port);
+}
+
+const char* udp_transport_t::receive(size_t& len, uint32_t timeout_usec_)
+{
+  // the sending socket has no timeout before the first call:
+  if(!has_timeout || (timeout_usec_ != timeout_usec)) {
+    timeout_usec = timeout_usec_;
+    socket.set_timeout_usec(timeout_usec);
+    has_timeout = true;
+  }
+  ssize_t n(socket.recvfrom(recbuf.data(), recbuf.size(), sender_endpoint));
+  if(n <= 0)
+    return NULL;
+  has_sender = true;
+  len = n;
+  return recbuf.data();
+}
+
+bool udp_transport_t::reply(const char* data, size_t len)
+{
+  if(!has_sender)
+    return false;
+  socket.send(data, len, sender_endpoint);
+  return true;
+}
+
+const char* udp_transport_t::receive_reply(size_t& len, uint32_t timeout_usec)
+{
+  // replies arrive at the sending socket:
+  return receive(len, timeout_usec);
+}
+
+shm_transport_t::shm_transport_t(const std::string& name)
+    : ring(new shmring_t(name))
+{
+}
+
+shm_transport_t::~shm_transport_t()
+{
+  delete ring;
+}
+
+char* shm_transport_t::borrow(size_t len)
+{
+  return ring->borrow(len);
+}
+
+void shm_transport_t::commit(size_t len)
+{
+  ring->commit(len);
+}
+
+const char* shm_transport_t::receive(size_t& len, uint32_t timeout_usec)
+{
+  return ring->peek(len, timeout_usec);
+}
+
+void shm_transport_t::release()
+{
+  ring->release();
+}
+
+struct loopback_transport_t::queue_t {
+  queue_t(size_t slots, size_t maxlen)
+      : slots(std::max((size_t)1u, slots)), maxlen(maxlen),
+        data(this->slots * maxlen), lens(this->slots)
+  {
+  }
+  const size_t slots;
+  const size_t maxlen;
+  std::vector<char> data;
+  std::vector<size_t> lens;
+  std::atomic<uint64_t> head = 0;
+  std::atomic<uint64_t> tail = 0;
+  std::atomic<size_t> dropped = 0;
+};
+
+std::shared_ptr<loopback_transport_t::queue_t>
+loopback_transport_t::get_queue(const std::string& name, size_t slots,
+                                size_t maxlen)
+{
+  static std::mutex mtx;
+  static std::map<std::string, std::weak_ptr<queue_t>> queues;
+  std::lock_guard<std::mutex> lock(mtx);
+  std::shared_ptr<queue_t> q(queues[name].lock());
+  if(!q) {
+    q = std::make_shared<queue_t>(slots, maxlen);
+    queues[name] = q;
+  }
+  return q;
+}
+
+loopback_transport_t::loopback_transport_t(const std::string& name,
+                                           size_t slots, size_t maxlen)
+    : queue(get_queue(name, slots, maxlen)),
+      // the name of the reply queue can not be used for a forward
+      // queue, since names of forward queues do not contain newlines:
+      replies(get_queue(name + "\nreply", slots, maxlen))
+{
+}
+
+static char* queue_borrow(loopback_transport_t::queue_t& queue, size_t len)
+{
+  uint64_t head(queue.head.load(std::memory_order_relaxed));
+  if((len > queue.maxlen) || (head - queue.tail.load() >= queue.slots)) {
+    ++queue.dropped;
+    return NULL;
+  }
+  return &(queue.data[(head % queue.slots) * queue.maxlen]);
+}
+
+static void queue_commit(loopback_transport_t::queue_t& queue, size_t len)
+{
+  uint64_t head(queue.head.load(std::memory_order_relaxed));
+  queue.lens[head % queue.slots] = len;
+  queue.head.store(head + 1u, std::memory_order_release);
+}
+
+static const char* queue_receive(loopback_transport_t::queue_t& queue,
+                                 size_t& len, uint32_t timeout_usec)
+{
+  uint64_t deadline(get_time_ns() + 1000ull * timeout_usec);
+  uint64_t tail(queue.tail.load(std::memory_order_relaxed));
+  while(queue.head.load(std::memory_order_acquire) == tail) {
+    if(get_time_ns() >= deadline)
+      return NULL;
+    usleep(100);
+  }
+  len = queue.lens[tail % queue.slots];
+  return &(queue.data[(tail % queue.slots) * queue.maxlen]);
+}
+
+static void queue_release(loopback_transport_t::queue_t& queue)
+{
+  uint64_t tail(queue.tail.load(std::memory_order_relaxed));
+  if(queue.head.load(std::memory_order_acquire) != tail)
+    queue.tail.store(tail + 1u, std::memory_order_release);
+}
+
+char* loopback_transport_t::borrow(size_t len)
+{
+  return queue_borrow(*queue, len);
+}
+
+void loopback_transport_t::commit(size_t len)
+{
+  queue_commit(*queue, len);
+}
+
+const char* loopback_transport_t::receive(size_t& len, uint32_t timeout_usec)
+{
+  return queue_receive(*queue, len, timeout_usec);
+}
+
+void loopback_transport_t::release()
+{
+  queue_release(*queue);
+}
+
+bool loopback_transport_t::reply(const char* data, size_t len)
+{
+  char* buf(queue_borrow(*replies, len));
+  if(!buf)
+    return false;
+  memcpy(buf, data, len);
+  queue_commit(*replies, len);
+  return true;
+}
+
+const char* loopback_transport_t::receive_reply(size_t& len,
+                                                uint32_t timeout_usec)
+{
+  const char* data(queue_receive(*replies, len, timeout_usec));
+  if(!data)
+    return NULL;
+  replybuf.assign(data, data + len);
+  queue_release(*replies);
+  return replybuf.data();
+}
+
+size_t loopback_transport_t::get_dropped() const
+{
+  return queue->dropped;
+}
+
+file_transport_t::file_transport_t(const std::string& path, bool replay,
+                                   bool realtime)
+    : writer(NULL), reader(NULL), realtime(realtime), start(get_time_ns()),
+      timestamp(0)
+{
+  if(replay)
+    reader = new capture_reader_t(path);
+  else
+    writer = new capture_writer_t(path);
+}
+
+file_transport_t::~file_transport_t()
+{
+  delete writer;
+  delete reader;
+}
+
+char* file_transport_t::borrow(size_t len)
+{
+  if(!writer)
+    return NULL;
+  if(buf.size() < len)
+    buf.resize(len);
+  return buf.data();
+}
+
+void file_transport_t::commit(size_t len)
+{
+  writer->write(buf.data(), len, get_time_ns());
+}
+
+const char* file_transport_t::receive(size_t& len, uint32_t timeout_usec)
+{
+  const char* data(NULL);
+  if(!reader || !reader->next(data, len, timestamp)) {
+    // end of file, behave like a silent network:
+    usleep(timeout_usec);
+    return NULL;
+  }
+  if(realtime) {
+    uint64_t now(get_time_ns() - start);
+    if(timestamp > now)
+      usleep((timestamp - now) / 1000u);
+  }
+  return data;
+}
+
+netaudio_transport_t* create_transport(const std::string& host, int32_t port,
+                                       bool receiver)
+{
+  if(host.compare(0, 4, "shm:") == 0)
+    return new shm_transport_t(host.substr(4));
+  if(host.compare(0, 5, "file:") == 0)
+    return new file_transport_t(host.substr(5), receiver, receiver);
+  if(host.compare(0, 9, "loopback:") == 0)
+    return new loopback_transport_t(host.substr(9));
+  return new udp_transport_t(receiver ? std::string("") : host, port);
+}
+
+/*
+ * Local Variables:
+ * mode: c++
+ * c-basic-offset: 2
+ * indent-tabs-mode: nil
+ * compile-command: "make -C .."
+ * End:
+ */
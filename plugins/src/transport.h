@@ -0,0 +1,228 @@
+/**
+ * @file transport.h
+ * @brief Packet transports between netaudio senders and receivers
+ */
+
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include <atomic>
+#include <memory>
+#include <stdint.h>
+#include <string>
+#include <udpsocket.h>
+#include <vector>
+
+class shmring_t;
+class capture_writer_t;
+class capture_reader_t;
+
+/**
+ * @brief Base class of packet transports
+ *
+ * Packets are sent by borrowing a transport-owned buffer, encoding
+ * into it and committing it. Received packets are lent by the
+ * transport until they are released. A transport instance is used by
+ * one sending and one receiving thread at most.
+ */
+class netaudio_transport_t {
+public:
+  virtual ~netaudio_transport_t(){};
+  /**
+   * Borrow a buffer for the next outgoing packet.
+   *
+   * @param len Maximum packet size in bytes
+   * @return Pointer to buffer, or NULL if no buffer is available
+   *
+   * The buffer is valid until the next call of borrow() or commit().
+   * If commit() is not called, the packet is discarded.
+   */
+  virtual char* borrow(size_t len) = 0;
+  /**
+   * Send the packet in the buffer obtained by borrow().
+   *
+   * @param len Packet size in bytes
+   */
+  virtual void commit(size_t len) = 0;
+  /**
+   * Receive the next packet.
+   *
+   * @param[out] len Packet size in bytes
+   * @param timeout_usec Maximum time to wait for a packet
+   * @return Pointer to packet, or NULL if no packet was received
+   *
+   * The packet is valid until release() is called.
+   */
+  virtual const char* receive(size_t& len, uint32_t timeout_usec) = 0;
+  /**
+   * Release the packet returned by receive().
+   */
+  virtual void release(){};
+  /**
+   * Send a packet back to the sender of the latest received packet.
+   *
+   * @param data Packet data
+   * @param len Packet size in bytes
+   * @return True if the packet was sent, false if the transport has
+   * no return path or no packet was received yet
+   */
+  virtual bool reply(const char*, size_t) { return false; };
+  /**
+   * Receive a packet sent back by a receiver with reply().
+   *
+   * @param[out] len Packet size in bytes
+   * @param timeout_usec Maximum time to wait for a packet
+   * @return Pointer to packet, valid until the next call, or NULL if
+   * no packet was received
+   *
+   * This may be called by a thread other than the sending thread.
+   */
+  virtual const char* receive_reply(size_t& len, uint32_t timeout_usec);
+  /**
+   * Copy a packet into a borrowed buffer and commit it.
+   *
+   * @return True if the packet was sent
+   */
+  bool send(const char* data, size_t len);
+};
+
+/**
+ * @brief UDP transport based on udpsocket_t
+ */
+class udp_transport_t : public netaudio_transport_t {
+public:
+  /**
+   * @param host Destination host, or empty to receive on port
+   * @param port Destination or receiver port number
+   */
+  udp_transport_t(const std::string& host, int32_t port);
+  char* borrow(size_t len);
+  void commit(size_t len);
+  const char* receive(size_t& len, uint32_t timeout_usec);
+  bool reply(const char* data, size_t len);
+  const char* receive_reply(size_t& len, uint32_t timeout_usec);
+
+private:
+  udpsocket_t socket;
+  int32_t port;
+  // receive timeout which was applied to the socket:
+  uint32_t timeout_usec;
+  bool has_timeout = false;
+  endpoint_t sender_endpoint;
+  bool has_sender = false;
+  std::vector<char> sendbuf;
+  std::vector<char> recbuf;
+};
+
+/**
+ * @brief Shared memory transport, see shmring_t
+ */
+class shm_transport_t : public netaudio_transport_t {
+public:
+  shm_transport_t(const std::string& name);
+  ~shm_transport_t();
+  char* borrow(size_t len);
+  void commit(size_t len);
+  const char* receive(size_t& len, uint32_t timeout_usec);
+  void release();
+
+private:
+  shmring_t* ring;
+};
+
+/**
+ * @brief In-memory transport within one process
+ *
+ * All instances created with the same name share one packet queue,
+ * i.e., packets committed to one instance are received by the
+ * other. Packets are dropped if the queue is full. Replies are passed
+ * through a second queue.
+ */
+class loopback_transport_t : public netaudio_transport_t {
+public:
+  /**
+   * @param name Name of the shared queue
+   * @param slots Maximum number of queued packets
+   * @param maxlen Maximum packet size in bytes
+   */
+  loopback_transport_t(const std::string& name, size_t slots = 64,
+                       size_t maxlen = 65536);
+  char* borrow(size_t len);
+  void commit(size_t len);
+  const char* receive(size_t& len, uint32_t timeout_usec);
+  void release();
+  bool reply(const char* data, size_t len);
+  const char* receive_reply(size_t& len, uint32_t timeout_usec);
+  /// Number of packets dropped because the queue was full
+  size_t get_dropped() const;
+  /// Packet queue shared between instances, defined in transport.cc
+  struct queue_t;
+
+private:
+  static std::shared_ptr<queue_t> get_queue(const std::string& name,
+                                            size_t slots, size_t maxlen);
+  std::shared_ptr<queue_t> queue;
+  std::shared_ptr<queue_t> replies;
+  std::vector<char> replybuf;
+};
+
+/**
+ * @brief Capture file transport
+ *
+ * A sending instance appends all packets with timestamps to a capture
+ * file. A receiving instance replays the packets of a capture file,
+ * either as fast as they are requested or paced by their
+ * timestamps. See capture.h for the file format.
+ */
+class file_transport_t : public netaudio_transport_t {
+public:
+  /**
+   * @param path File name
+   * @param replay Read packets from file instead of writing
+   * @param realtime Replay packets with their original timing
+   */
+  file_transport_t(const std::string& path, bool replay,
+                   bool realtime = false);
+  ~file_transport_t();
+  char* borrow(size_t len);
+  void commit(size_t len);
+  const char* receive(size_t& len, uint32_t timeout_usec);
+  /// Timestamp of last received packet, in ns since start of capture
+  uint64_t get_timestamp() const { return timestamp; };
+
+private:
+  capture_writer_t* writer;
+  capture_reader_t* reader;
+  bool realtime;
+  uint64_t start;
+  uint64_t timestamp;
+  std::vector<char> buf;
+};
+
+/**
+ * Create a transport from a host description.
+ *
+ * @param host "shm:name", "file:path", "loopback:name", or a host
+ * name for UDP (empty for receivers)
+ * @param port UDP port number
+ * @param receiver True for receivers, false for senders
+ * @return New transport, to be deleted by the caller
+ */
+netaudio_transport_t* create_transport(const std::string& host, int32_t port,
+                                       bool receiver);
+
+/**
+ * Return time of monotonic clock in nanoseconds.
+ */
+uint64_t get_time_ns();
+
+#endif
+
+/*
+ * Local Variables:
+ * mode: c++
+ * c-basic-offset: 2
+ * indent-tabs-mode: nil
+ * compile-command: "make -C .."
+ * End:
+ */
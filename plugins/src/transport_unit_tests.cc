@@ -0,0 +1,188 @@
+#include <gtest/gtest.h>
+
+#include "netaudio.h"
+#include "ringbuffer.h"
+#include "shmring.h"
+#include "transport.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+TEST(transport, loopback)
+{
+  loopback_transport_t sender("loopback_test", 4, 64);
+  loopback_transport_t receiver("loopback_test");
+  size_t len(0);
+  EXPECT_TRUE(receiver.receive(len, 0) == NULL);
+  char* buf(sender.borrow(5));
+  ASSERT_TRUE(buf != NULL);
+  memcpy(buf, "hello", 5);
+  sender.commit(5);
+  const char* packet(receiver.receive(len, 0));
+  ASSERT_TRUE(packet != NULL);
+  EXPECT_EQ(5u, len);
+  EXPECT_EQ(0, memcmp(packet, "hello", 5));
+  receiver.release();
+  EXPECT_TRUE(receiver.receive(len, 1000) == NULL);
+  // queue full and packet too large:
+  for(size_t k = 0; k < 4; ++k)
+    EXPECT_TRUE(sender.send("x", 1));
+  EXPECT_FALSE(sender.send("x", 1));
+  EXPECT_TRUE(sender.borrow(65) == NULL);
+  EXPECT_EQ(2u, sender.get_dropped());
+  // uncommitted buffers are discarded:
+  for(size_t k = 0; k < 4; ++k) {
+    ASSERT_TRUE(receiver.receive(len, 0) != NULL);
+    receiver.release();
+  }
+  sender.borrow(1);
+  EXPECT_TRUE(receiver.receive(len, 0) == NULL);
+}
+
+TEST(transport, loopback_reply)
+{
+  loopback_transport_t sender("reply_test", 4, 64);
+  loopback_transport_t receiver("reply_test");
+  size_t len(0);
+  EXPECT_TRUE(sender.receive_reply(len, 0) == NULL);
+  EXPECT_TRUE(receiver.reply("report", 6));
+  // replies are not received by the forward path:
+  EXPECT_TRUE(receiver.receive(len, 0) == NULL);
+  const char* packet(sender.receive_reply(len, 0));
+  ASSERT_TRUE(packet != NULL);
+  EXPECT_EQ(6u, len);
+  EXPECT_EQ(0, memcmp(packet, "report", 6));
+  EXPECT_TRUE(sender.receive_reply(len, 0) == NULL);
+  // a transport without return path:
+  char path[] = "/tmp/reply_test_XXXXXX";
+  int fd(mkstemp(path));
+  ASSERT_LE(0, fd);
+  close(fd);
+  file_transport_t file(path, false);
+  EXPECT_FALSE(file.reply("report", 6));
+  EXPECT_TRUE(file.receive_reply(len, 0) == NULL);
+  unlink(path);
+}
+
+TEST(transport, file_capture_replay)
+{
+  std::string path("/tmp/transport_test_" + std::to_string(getpid()) + ".nacp");
+  {
+    file_transport_t capture(path, false);
+    EXPECT_TRUE(capture.send("abc", 3));
+    EXPECT_TRUE(capture.send("0123456789", 10));
+    size_t len(0);
+    EXPECT_TRUE(capture.receive(len, 0) == NULL);
+  }
+  {
+    file_transport_t replay(path, true);
+    EXPECT_TRUE(replay.borrow(4) == NULL);
+    size_t len(0);
+    const char* packet(replay.receive(len, 0));
+    ASSERT_TRUE(packet != NULL);
+    EXPECT_EQ(3u, len);
+    EXPECT_EQ(0, memcmp(packet, "abc", 3));
+    uint64_t t1(replay.get_timestamp());
+    packet = replay.receive(len, 0);
+    ASSERT_TRUE(packet != NULL);
+    EXPECT_EQ(10u, len);
+    EXPECT_EQ(0, memcmp(packet, "0123456789", 10));
+    EXPECT_LE(t1, replay.get_timestamp());
+    EXPECT_TRUE(replay.receive(len, 0) == NULL);
+  }
+  unlink(path.c_str());
+  EXPECT_THROW(file_transport_t(path, true), std::runtime_error);
+}
+
+TEST(transport, create_transport)
+{
+  std::string name("transport_test_" + std::to_string(getpid()));
+  shmring_t::unlink(name);
+  netaudio_transport_t* sender(create_transport("shm:" + name, 0, false));
+  netaudio_transport_t* receiver(create_transport("shm:" + name, 0, true));
+  EXPECT_TRUE(dynamic_cast<shm_transport_t*>(sender) != NULL);
+  EXPECT_TRUE(sender->send("abc", 3));
+  size_t len(0);
+  const char* packet(receiver->receive(len, 0));
+  ASSERT_TRUE(packet != NULL);
+  EXPECT_EQ(3u, len);
+  receiver->release();
+  delete sender;
+  delete receiver;
+  shmring_t::unlink(name);
+  netaudio_transport_t* loop(create_transport("loopback:x", 0, true));
+  EXPECT_TRUE(dynamic_cast<loopback_transport_t*>(loop) != NULL);
+  delete loop;
+}
+
+// Stream audio from encoder to jitter buffer without sockets: encode
+// into borrowed transport buffers, receive, decode and play out.
+TEST(transport, pipeline)
+{
+  const size_t fragsize(32);
+  const size_t channels(4);
+  loopback_transport_t sender("pipeline_test", 16);
+  loopback_transport_t receiver("pipeline_test");
+  netaudio_info_t info(new_netaudio_info(48000, pcmfloat, channels, fragsize));
+  ringbuffer_ooowrite_t rb(8 * fragsize, channels, fragsize);
+  float audio[fragsize * channels];
+  netaudio_info_t recinfo;
+  bool has_info(false);
+  uint64_t timeline((uint64_t)1u << 32);
+  bool has_timeline(false);
+  std::vector<float> output;
+  uint32_t sample_index(0xfffffff0u);
+  for(size_t n = 0; n < 20; ++n) {
+    netaudio_err_t err;
+    if(n % 8 == 0) {
+      char* buf(sender.borrow(get_buffer_length_header()));
+      ASSERT_TRUE(buf != NULL);
+      sender.commit(
+          encode_header(info, buf, get_buffer_length_header(), err));
+    }
+    for(size_t k = 0; k < fragsize; ++k)
+      for(size_t c = 0; c < channels; ++c)
+        audio[c + channels * k] = n * fragsize + k + 0.25f * c;
+    char* buf(sender.borrow(get_buffer_length(info)));
+    ASSERT_TRUE(buf != NULL);
+    sender.commit(encode_audio(info, audio, fragsize * channels, sample_index,
+                               buf, get_buffer_length(info), err));
+    sample_index += fragsize;
+    size_t len(0);
+    const char* packet;
+    while((packet = receiver.receive(len, 0))) {
+      if(decode_header(recinfo, packet, len, err)) {
+        has_info = true;
+      } else if(has_info) {
+        uint32_t recindex(0);
+        ASSERT_NE(0u, decode_audio(recinfo, audio, fragsize * channels,
+                                   recindex, packet, len, err));
+        if(!has_timeline) {
+          timeline += recindex;
+          has_timeline = true;
+        }
+        timeline = unwrap_sample_index(recindex, timeline);
+        rb.write_data(audio, recinfo.fragsize, recinfo.channels, timeline);
+      }
+      receiver.release();
+    }
+    rb.read_data(audio, fragsize, channels);
+    for(size_t k = 0; k < fragsize; ++k) {
+      if(n > 0) {
+        EXPECT_EQ(audio[channels * k] + 0.75f, audio[channels * k + 3]);
+      }
+      output.push_back(audio[channels * k]);
+    }
+  }
+  for(size_t k = 0; k < fragsize; ++k)
+    EXPECT_EQ(0.0f, output[k]);
+  for(size_t k = fragsize; k < output.size(); ++k)
+    ASSERT_EQ((float)(k - fragsize), output[k]);
+}
+
+// Local Variables:
+// compile-command: "make -C .. unit-tests"
+// coding: utf-8-unix
+// c-basic-offset: 2
+// indent-tabs-mode: nil
+// End:
@@ -0,0 +1,127 @@
+#include "workerpool.h"
+#include <algorithm>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// number of polls before a thread blocks in a futex:
+#define WORKERPOOL_SPIN 100
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t),
+              "32-bit atomics can not be used as futex");
+
+// wait until value differs from expected, with a short spin before
+// sleeping, since the next job or the last group often follows soon:
+static void wait_while(std::atomic<uint32_t>& value, uint32_t expected,
+                       std::atomic<uint32_t>& waiting)
+{
+  for(size_t k = 0; k < WORKERPOOL_SPIN; ++k) {
+    if(value.load(std::memory_order_acquire) != expected)
+      return;
+    std::this_thread::yield();
+  }
+  // announce waiting before checking again, so that wake() does not
+  // miss the wake-up:
+  waiting.store(1u);
+  while(value.load() == expected)
+    syscall(SYS_futex, &value, FUTEX_WAIT_PRIVATE, expected, NULL, NULL, 0);
+  waiting.store(0u);
+}
+
+static void wake(std::atomic<uint32_t>& value, std::atomic<uint32_t>& waiting)
+{
+  if(waiting.load())
+    syscall(SYS_futex, &value, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+}
+
+float* aligned_audio_alloc(size_t num_elem)
+{
+  // the size must be a multiple of the alignment:
+  size_t lines(std::max(
+      (size_t)1u,
+      (sizeof(float) * num_elem + WORKERPOOL_CACHELINE - 1u) /
+          WORKERPOOL_CACHELINE));
+  return (float*)aligned_alloc(WORKERPOOL_CACHELINE,
+                               WORKERPOOL_CACHELINE * lines);
+}
+
+// groups consist of whole cache lines of float samples:
+#define WORKERPOOL_UNIT (WORKERPOOL_CACHELINE / sizeof(float))
+
+worker_pool_t::worker_pool_t(size_t channels, size_t threads_)
+{
+  // no more threads than groups of the maximum number of channels:
+  size_t units((channels + WORKERPOOL_UNIT - 1u) / WORKERPOOL_UNIT);
+  threads = std::max((size_t)1u, std::min(threads_, units));
+  slots = new slot_t[threads];
+  partition(channels);
+  for(size_t k = 1; k < threads; ++k)
+    slots[k].thread = std::thread(&worker_pool_t::worker, this, k);
+}
+
+void worker_pool_t::partition(size_t channels)
+{
+  size_t units((channels + WORKERPOOL_UNIT - 1u) / WORKERPOOL_UNIT);
+  groups = std::max((size_t)1u, std::min(threads, units));
+  for(size_t k = 0; k < threads; ++k) {
+    slots[k].first =
+        std::min(channels, WORKERPOOL_UNIT * (k * units / groups));
+    slots[k].last =
+        std::min(channels, WORKERPOOL_UNIT * ((k + 1u) * units / groups));
+  }
+}
+
+worker_pool_t::~worker_pool_t()
+{
+  run_workers = false;
+  for(size_t k = 1; k < threads; ++k) {
+    slots[k].job.fetch_add(1u);
+    wake(slots[k].job, slots[k].waiting);
+    slots[k].thread.join();
+  }
+  delete[] slots;
+}
+
+void worker_pool_t::run_job(void (*fn_)(const void*, size_t, size_t),
+                            const void* job_)
+{
+  fn = fn_;
+  job = job_;
+  ++jobs;
+  pending.store(groups - 1u, std::memory_order_relaxed);
+  for(size_t k = 1; k < groups; ++k) {
+    slots[k].job.store(jobs);
+    wake(slots[k].job, slots[k].waiting);
+  }
+  fn(job, slots[0].first, slots[0].last);
+  uint32_t p(pending.load(std::memory_order_acquire));
+  while(p) {
+    wait_while(pending, p, caller_waiting);
+    p = pending.load(std::memory_order_acquire);
+  }
+}
+
+void worker_pool_t::worker(size_t group)
+{
+  slot_t& slot(slots[group]);
+  uint32_t done(0);
+  while(true) {
+    wait_while(slot.job, done, slot.waiting);
+    if(!run_workers)
+      break;
+    // groups which were not in use skip the jobs of the other groups:
+    done = slot.job.load(std::memory_order_acquire);
+    fn(job, slot.first, slot.last);
+    if(pending.fetch_sub(1u) == 1u)
+      wake(pending, caller_waiting);
+  }
+}
+
+/*
+ * Local Variables:
+ * mode: c++
+ * c-basic-offset: 2
+ * indent-tabs-mode: nil
+ * compile-command: "make -C .."
+ * End:
+ */
@@ -0,0 +1,121 @@
+/**
+ * @file workerpool.h
+ * @brief Parallel processing of channel groups
+ */
+
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+
+#include <atomic>
+#include <stdint.h>
+#include <stdlib.h>
+#include <thread>
+
+/// Size of a cache line in bytes, to avoid false sharing between threads
+#define WORKERPOOL_CACHELINE 64u
+
+/**
+ * Allocate a buffer for audio samples which starts at a cache line.
+ *
+ * @param num_elem Number of samples
+ * @return Buffer, to be released with free()
+ */
+float* aligned_audio_alloc(size_t num_elem);
+
+/**
+ * @brief Pool of threads which process a job for groups of channels
+ *
+ * The channels are statically partitioned into one group per
+ * thread. Group boundaries are multiples of 16 channels, i.e., of a
+ * cache line of float samples. If the number of channels is a
+ * multiple of 16 and the buffer is aligned, every interleaved frame
+ * starts at a cache line, and threads writing their groups do not
+ * share cache lines. Otherwise, only the cache lines at group
+ * boundaries may be shared. The calling thread processes the first
+ * group, the other groups are processed by worker threads.
+ *
+ * Jobs are handed over with atomic counters, without locks or memory
+ * allocation. The call returns when all groups are processed. Idle
+ * workers and the waiting caller poll briefly, then sleep in a futex
+ * until they are woken. Since the caller depends on the workers, run()
+ * must not be called by the real-time audio thread.
+ *
+ * Only one thread may call run().
+ */
+class worker_pool_t {
+public:
+  /**
+   * @param channels Maximum number of channels
+   * @param threads Maximum number of threads, including the caller
+   * of run()
+   */
+  worker_pool_t(size_t channels, size_t threads);
+  ~worker_pool_t();
+  /**
+   * Process all channel groups.
+   *
+   * @param job Function or function object, called as job(first,
+   * last) for the channels first to last-1 of each group
+   */
+  template <class F> void run(const F& job)
+  {
+    run_job(&call<F>, &job);
+  };
+  /**
+   * Partition a different number of channels, without creating
+   * threads.
+   *
+   * @param channels Number of channels, up to the maximum given to
+   * the constructor
+   *
+   * Must not be called while run() is active.
+   */
+  void partition(size_t channels);
+  /// Number of channel groups, which is the number of threads in use
+  size_t get_groups() const { return groups; };
+  /// First channel of a group
+  size_t get_first(size_t group) const { return slots[group].first; };
+  /// Channel following the last channel of a group
+  size_t get_last(size_t group) const { return slots[group].last; };
+
+private:
+  template <class F>
+  static void call(const void* job, size_t first, size_t last)
+  {
+    (*(const F*)job)(first, last);
+  };
+  void run_job(void (*fn)(const void*, size_t, size_t), const void* job);
+  void worker(size_t group);
+  // state of one group, in a separate cache line:
+  struct alignas(WORKERPOOL_CACHELINE) slot_t {
+    size_t first = 0;
+    size_t last = 0;
+    // sequence number of the latest job started in this group, used
+    // as futex:
+    std::atomic<uint32_t> job = 0;
+    // the worker sleeps in the futex:
+    std::atomic<uint32_t> waiting = 0;
+    std::thread thread;
+  };
+  size_t threads;
+  size_t groups;
+  slot_t* slots;
+  void (*fn)(const void*, size_t, size_t) = NULL;
+  const void* job = NULL;
+  uint32_t jobs = 0;
+  // number of groups which are not processed yet, used as futex:
+  alignas(WORKERPOOL_CACHELINE) std::atomic<uint32_t> pending = 0;
+  std::atomic<uint32_t> caller_waiting = 0;
+  std::atomic_bool run_workers = true;
+};
+
+#endif
+
+/*
+ * Local Variables:
+ * mode: c++
+ * c-basic-offset: 2
+ * indent-tabs-mode: nil
+ * compile-command: "make -C .."
+ * End:
+ */
@@ -0,0 +1,54 @@
+#include <benchmark/benchmark.h>
+
+#include "netaudio.h"
+#include "workerpool.h"
+#include <thread>
+#include <vector>
+
+// Scaling of decoding with the number of threads, from one thread to
+// the number of cores, for 128 channels. Resampling is not measured,
+// since it runs on the audio thread without worker threads, see
+// BM_resampler_read. Wall clock time is measured, since most of the
+// work is done by the worker threads:
+static void thread_counts(benchmark::internal::Benchmark* b)
+{
+  size_t cores(std::max(1u, std::thread::hardware_concurrency()));
+  for(size_t threads = 1; threads <= cores; ++threads)
+    b->Args({128, (int64_t)threads});
+}
+
+// Decoding of a 16 bit chunk in channel groups, as in the receiver:
+static void BM_parallel_decode(benchmark::State& state)
+{
+  size_t channels(state.range(0));
+  size_t frames(64);
+  worker_pool_t pool(channels, state.range(1));
+  netaudio_info_t info(new_netaudio_info(48000, pcm16bit, channels, frames));
+  netaudio_codec_t codec(new_netaudio_codec(info));
+  float* audio(aligned_audio_alloc(channels * frames));
+  std::vector<float> in(channels * frames, 0.25f);
+  std::vector<char> data(get_buffer_length(info));
+  netaudio_err_t err;
+  encode_audio(codec, in.data(), in.size(), 0, data.data(), data.size(), err);
+  for(auto _ : state) {
+    pool.run([&](size_t first, size_t last) {
+      netaudio_err_t group_err;
+      uint32_t sample_index(0);
+      decode_audio_channels(codec, audio, channels * frames, sample_index,
+                            data.data(), data.size(), first, last, group_err);
+    });
+    benchmark::DoNotOptimize(audio);
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * channels * frames);
+  state.counters["groups"] = pool.get_groups();
+  free(audio);
+}
+BENCHMARK(BM_parallel_decode)->Apply(thread_counts)->UseRealTime();
+
+// Local Variables:
+// compile-command: "make -C .. benchmarks"
+// coding: utf-8-unix
+// c-basic-offset: 2
+// indent-tabs-mode: nil
+// End:
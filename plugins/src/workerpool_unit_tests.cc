@@ -0,0 +1,119 @@
+#include <gtest/gtest.h>
+
+#include "workerpool.h"
+#include <unistd.h>
+#include <vector>
+
+TEST(worker_pool, groups)
+{
+  // groups of 16 channels, one float cache line:
+  worker_pool_t pool(40, 4);
+  ASSERT_EQ(3u, pool.get_groups());
+  EXPECT_EQ(0u, pool.get_first(0));
+  EXPECT_EQ(16u, pool.get_last(0));
+  EXPECT_EQ(16u, pool.get_first(1));
+  EXPECT_EQ(32u, pool.get_last(1));
+  EXPECT_EQ(32u, pool.get_first(2));
+  EXPECT_EQ(40u, pool.get_last(2));
+  worker_pool_t pool2(128, 3);
+  ASSERT_EQ(3u, pool2.get_groups());
+  EXPECT_EQ(32u, pool2.get_last(0));
+  EXPECT_EQ(80u, pool2.get_last(1));
+  EXPECT_EQ(128u, pool2.get_last(2));
+  // at least one group:
+  worker_pool_t pool3(4, 0);
+  ASSERT_EQ(1u, pool3.get_groups());
+  EXPECT_EQ(4u, pool3.get_last(0));
+  // repartition without creating threads:
+  pool2.partition(20);
+  ASSERT_EQ(2u, pool2.get_groups());
+  EXPECT_EQ(0u, pool2.get_first(0));
+  EXPECT_EQ(16u, pool2.get_last(0));
+  EXPECT_EQ(16u, pool2.get_first(1));
+  EXPECT_EQ(20u, pool2.get_last(1));
+  pool2.partition(128);
+  ASSERT_EQ(3u, pool2.get_groups());
+  EXPECT_EQ(80u, pool2.get_last(1));
+  // buffers start at a cache line:
+  float* buf(aligned_audio_alloc(5));
+  EXPECT_EQ(0u, (size_t)buf % WORKERPOOL_CACHELINE);
+  free(buf);
+}
+
+TEST(worker_pool, run)
+{
+  const size_t channels(100);
+  worker_pool_t pool(channels, 4);
+  ASSERT_EQ(4u, pool.get_groups());
+  std::vector<size_t> count(channels, 0u);
+  for(size_t n = 0; n < 10000; ++n) {
+    // all groups are processed when run() returns:
+    pool.run([&](size_t first, size_t last) {
+      for(size_t c = first; c < last; ++c)
+        ++count[c];
+    });
+    for(size_t c = 0; c < channels; ++c)
+      ASSERT_EQ(n + 1u, count[c]) << c;
+  }
+  // fewer channels use fewer groups, the idle workers keep waiting:
+  pool.partition(10);
+  ASSERT_EQ(1u, pool.get_groups());
+  pool.run([&](size_t first, size_t last) {
+    for(size_t c = first; c < last; ++c)
+      ++count[c];
+  });
+  EXPECT_EQ(10001u, count[9]);
+  EXPECT_EQ(10000u, count[10]);
+}
+
+TEST(worker_pool, shrink_grow)
+{
+  const size_t channels(128);
+  worker_pool_t pool(channels, 3);
+  std::vector<size_t> count(channels, 0u);
+  auto job = [&](size_t first, size_t last) {
+    for(size_t c = first; c < last; ++c)
+      ++count[c];
+  };
+  for(size_t n = 0; n < 3; ++n)
+    pool.run(job);
+  pool.partition(10);
+  for(size_t n = 0; n < 3; ++n)
+    pool.run(job);
+  // resumed workers process only the latest job, once:
+  pool.partition(channels);
+  ASSERT_EQ(3u, pool.get_groups());
+  pool.run(job);
+  EXPECT_EQ(7u, count[0]);
+  EXPECT_EQ(7u, count[9]);
+  EXPECT_EQ(4u, count[10]);
+  for(size_t c = 16; c < channels; ++c)
+    ASSERT_EQ(4u, count[c]) << c;
+}
+
+TEST(worker_pool, sleeping_workers)
+{
+  const size_t channels(64);
+  worker_pool_t pool(channels, 4);
+  std::vector<size_t> count(channels, 0u);
+  for(size_t n = 0; n < 20; ++n) {
+    // idle workers block in the futex, and are woken by run():
+    usleep(2000);
+    pool.run([&](size_t first, size_t last) {
+      // the caller waits for slow groups:
+      if(first)
+        usleep(1000);
+      for(size_t c = first; c < last; ++c)
+        ++count[c];
+    });
+    for(size_t c = 0; c < channels; ++c)
+      ASSERT_EQ(n + 1u, count[c]) << c;
+  }
+}
+
+// Local Variables:
+// compile-command: "make -C .. unit-tests"
+// coding: utf-8-unix
+// c-basic-offset: 2
+// indent-tabs-mode: nil
+// End: